@@ -0,0 +1,111 @@
+#include <string.h>
+#include "backing_store.h"
+
+static const char *inclusion_names[] = {"nine", "incl", "excl"};
+static const char *write_hit_names[] = {"back", "through"};
+static const char *write_miss_names[] = {"alloc", "noalloc", "around"};
+
+//----------------------
+// linkBackingStores
+//
+// Arguments: upper - store of the level that misses into lower
+//            lower - store of the level below upper
+//            inclusion - how lower treats blocks held by upper
+//
+// Results: 0 and the levels linked on success, -1 if the link is not
+//          supported (see backing_store.h). Neither store is changed
+//          on failure.
+//
+int linkBackingStores(BackingStore *upper, BackingStore *lower, InclusionPolicy inclusion) {
+    if (upper == NULL || lower == NULL || lower->invalidate_block == NULL) {
+        return -1;
+    }
+    if (upper->address_width != lower->address_width ||
+        upper->block_words > lower->block_words ||
+        lower->above != NULL) {
+        return -1;
+    }
+    if (inclusion == INCLUSION_EXCLUSIVE &&
+        (!upper->write_back || !lower->write_back || upper->block_words != lower->block_words)) {
+        return -1;
+    }
+
+    upper->next = lower;
+    lower->above = upper;
+    lower->inclusion = inclusion;
+    return 0;
+}
+
+int parseInclusionPolicy(const char *name, InclusionPolicy *inclusion) {
+    for (uint32_t i = 0; i < sizeof(inclusion_names) / sizeof(inclusion_names[0]); i++) {
+        if (strcmp(name, inclusion_names[i]) == 0) {
+            *inclusion = (InclusionPolicy) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *inclusionPolicyName(InclusionPolicy inclusion) {
+    if ((uint32_t) inclusion < sizeof(inclusion_names) / sizeof(inclusion_names[0])) {
+        return inclusion_names[inclusion];
+    }
+    return "unknown";
+}
+
+int parseWritePolicy(const char *name, WritePolicy *policy) {
+    for (uint32_t i = 0; i < sizeof(write_hit_names) / sizeof(write_hit_names[0]); i++) {
+        if (strcmp(name, write_hit_names[i]) == 0) {
+            policy->hit = (WriteHitPolicy) i;
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < sizeof(write_miss_names) / sizeof(write_miss_names[0]); i++) {
+        if (strcmp(name, write_miss_names[i]) == 0) {
+            policy->miss = (WriteMissPolicy) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *writeHitPolicyName(WriteHitPolicy hit) {
+    if ((uint32_t) hit < sizeof(write_hit_names) / sizeof(write_hit_names[0])) {
+        return write_hit_names[hit];
+    }
+    return "unknown";
+}
+
+const char *writeMissPolicyName(WriteMissPolicy miss) {
+    if ((uint32_t) miss < sizeof(write_miss_names) / sizeof(write_miss_names[0])) {
+        return write_miss_names[miss];
+    }
+    return "unknown";
+}
+
+uint32_t mergeByte(uint32_t word, uint32_t address, uint8_t value) {
+    uint32_t shift = 8 * (address & 3);
+    return (word & ~(0xffu << shift)) | ((uint32_t) value << shift);
+}
+
+//----------------------
+// storeWriteByte
+//
+// Arguments: store - store to write to
+//            address - byte address
+//            value - byte to write
+//
+// Results: 0 on success, -1 if the read or write fails. The word holding
+//          address is read from store, so a cache below may allocate it.
+//          An exclusive store keeps its block, and the write updates it.
+//
+int storeWriteByte(BackingStore *store, uint32_t address, uint8_t value) {
+    uint32_t word_addr = address & ~(uint32_t) 3;
+    uint32_t word;
+    uint8_t dirty;
+    if (store->read_block(store->impl, word_addr, &word, 1, &dirty) != 0) {
+        return -1;
+    }
+    word = mergeByte(word, address, value);
+    return store->write_block(store->impl, word_addr, &word, 1, STORE_WRITE_THROUGH);
+}
@@ -0,0 +1,123 @@
+#ifndef BACKING_STORE_H
+#define BACKING_STORE_H
+#include <stdint.h>
+
+// BackingStore
+//
+// Block level interface shared by MainMem and every cache so that caches
+// can be stacked into a hierarchy (L1 -> L2 -> ... -> MainMem). Each
+// cache fills and writes back through the store of the level below it
+// (next) and, when that level keeps inclusion, is told through its own
+// store when a block must leave (invalidate_block).
+//
+// Blocks move between levels whole: an upper level transfers its own
+// block size, which must not exceed the block size of the level below.
+// Each store callback returns 0 on success and -1 on failure.
+//
+// Inclusion is a property of the lower level of each link:
+//
+//   INCLUSION_NON_INCLUSIVE  levels allocate and evict independently
+//   INCLUSION_INCLUSIVE      every block above is also held here; evicting
+//                            a block here first invalidates it above,
+//                            collecting any dirty data
+//   INCLUSION_EXCLUSIVE      a block is held here or above, not both. A
+//                            block handed up is dropped here (its dirty
+//                            state travels with it) and every block evicted
+//                            above is inserted here, clean or dirty. A read
+//                            of part of a block is not a hand up: the block
+//                            stays here. Both levels must be write back
+//                            with equal blocks.
+
+typedef enum {INCLUSION_NON_INCLUSIVE,
+              INCLUSION_INCLUSIVE,
+              INCLUSION_EXCLUSIVE
+} InclusionPolicy;
+
+// Kinds of block written into a store by the level above
+typedef enum {STORE_WRITE_BACK,      // Dirty block being evicted or flushed
+              STORE_WRITE_THROUGH,   // Words written by a write through level
+              STORE_CLEAN_VICTIM     // Clean block evicted into an exclusive level
+} StoreWriteKind;
+
+// Write policies of a cache. The hit policy decides whether a written
+// line is marked dirty (write back) or the word is also written to the
+// level below at once (write through). The miss policy decides what a
+// write to a block that is not resident does:
+//
+//   WRITE_MISS_ALLOCATE     fill the block, then write it as a hit
+//   WRITE_MISS_NO_ALLOCATE  write the word to the level below only
+//   WRITE_MISS_AROUND       as no allocate, and a write that hits also
+//                           bypasses the cache, evicting the line (a
+//                           streaming store)
+//
+// Stores move whole words, so a byte written to the level below is first
+// merged into the word read from it.
+
+typedef enum {WRITE_HIT_BACK, WRITE_HIT_THROUGH} WriteHitPolicy;
+
+typedef enum {WRITE_MISS_ALLOCATE,
+              WRITE_MISS_NO_ALLOCATE,
+              WRITE_MISS_AROUND
+} WriteMissPolicy;
+
+typedef struct WritePolicy {
+    WriteHitPolicy hit;
+    WriteMissPolicy miss;
+} WritePolicy;
+
+typedef struct BackingStore {
+    void *impl;                     // MainMem or cache implementing the store
+    uint32_t address_width;
+    uint32_t block_words;           // Block size of this level, 1 for MainMem
+    uint32_t write_back;            // Non-zero if this level holds dirty blocks
+    InclusionPolicy inclusion;      // Relationship to the level above
+    struct BackingStore *next;      // Level below, NULL for MainMem
+    struct BackingStore *above;     // Level above, NULL for the top level
+
+    // Reads count words at address into values. *dirty is set if the
+    // block was handed up dirty by an exclusive level.
+    int (*read_block)(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty);
+    // Writes count words at address from values
+    int (*write_block)(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind);
+    // Drops every block within count words at address, writing dirty
+    // data to next first. NULL for MainMem.
+    void (*invalidate_block)(void *impl, uint32_t address, uint32_t count);
+} BackingStore;
+
+// Stacks upper on top of lower with the given inclusion policy. Returns 0
+// on success, -1 if the levels cannot be linked (different address
+// widths, upper blocks larger than lower blocks, lower already has a
+// level above, or an exclusive link between levels that are not both
+// write back with equal block sizes).
+int linkBackingStores(BackingStore *upper, BackingStore *lower, InclusionPolicy inclusion);
+
+// Sets inclusion from its name (nine, incl, excl). Returns 0 on success,
+// -1 if name is unknown.
+int parseInclusionPolicy(const char *name, InclusionPolicy *inclusion);
+
+// Returns name of inclusion as accepted by parseInclusionPolicy
+const char *inclusionPolicyName(InclusionPolicy inclusion);
+
+// Sets the part of policy given by name: back or through for the hit
+// policy, alloc, noalloc or around for the miss policy. Returns 0 on
+// success, -1 if name is unknown.
+int parseWritePolicy(const char *name, WritePolicy *policy);
+
+// Return names of hit and miss as accepted by parseWritePolicy
+const char *writeHitPolicyName(WriteHitPolicy hit);
+const char *writeMissPolicyName(WriteMissPolicy miss);
+
+// Accesses ahead of the current one whose line metadata the batched
+// readBytes/writeBytes of every cache prefetch
+#define BATCH_PREFETCH_DISTANCE 8
+
+// Returns word with the byte at address (byte offset address & 3)
+// replaced by value
+uint32_t mergeByte(uint32_t word, uint32_t address, uint8_t value);
+
+// Writes byte value at address to store as a one word STORE_WRITE_THROUGH
+// write, merged into the word read from store. Returns 0 on success, -1
+// if the read or write fails.
+int storeWriteByte(BackingStore *store, uint32_t address, uint8_t value);
+
+#endif
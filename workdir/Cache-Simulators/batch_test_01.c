@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main_mem.h"
+#include "cache_model.h"
+#include "test_util.h"
+
+#define ADDRESS_WIDTH 14
+#define NUM_OPS 200000
+#define MAX_BATCH 40
+
+// Replays the same accesses through spec one byte at a time and in
+// batches of up to MAX_BATCH reads or writes, some out of range, and
+// checks that values, errors, counters and memory agree
+static void compareBatches(char *spec) {
+    MainMem *single_mem = createMainMem(ADDRESS_WIDTH);
+    MainMem *batch_mem = createMainMem(ADDRESS_WIDTH);
+    CacheModel *single = createModel(spec, single_mem);
+    CacheModel *batch = createModel(spec, batch_mem);
+
+    uint32_t addresses[MAX_BATCH];
+    uint8_t values[MAX_BATCH];
+    uint64_t total_errors = 0;
+    uint32_t r = 12345;
+    for (uint32_t i=0; i<NUM_OPS; ) {
+        r ^= r << 13;
+        r ^= r >> 17;
+        r ^= r << 5;
+        uint32_t count = 1 + r % MAX_BATCH;
+        int write = (r >> 8) % 3 == 0;
+        uint32_t single_errors = 0;
+        for (uint32_t j=0; j<count; j++, i++) {
+            uint32_t s = (r >> 12) * (j + 1) * 2654435761u;
+            addresses[j] = (s % 16) == 0 ? (s >> 4) & 0x3fff : (s >> 4) & 0x3ff;
+            if (s % 997 == 0) {
+                addresses[j] = (1 << ADDRESS_WIDTH) + 4;
+            }
+            if (write) {
+                values[j] = (uint8_t) (i + j);
+                single_errors += single->write_byte(single->cache, addresses[j], values[j]) != 0;
+            } else {
+                uint8_t value = 0;
+                single_errors += single->read_byte(single->cache, addresses[j], &value) != 0;
+                values[j] = value;
+            }
+        }
+
+        uint32_t batch_errors = 0;
+        int result;
+        if (write) {
+            result = batch->write_bytes(batch->cache, addresses, values, count, &batch_errors);
+        } else {
+            uint8_t expected[MAX_BATCH];
+            memcpy(expected, values, count);
+            memset(values, 0, count);
+            result = batch->read_bytes(batch->cache, addresses, values, count, &batch_errors);
+            for (uint32_t j=0; j<count; j++) {
+                if (addresses[j] < (1 << ADDRESS_WIDTH)) {
+                    checkCount("read value", values[j], expected[j]);
+                }
+            }
+        }
+        checkCount("errors", batch_errors, single_errors);
+        checkCount("result is an error", result != 0, single_errors != 0);
+        total_errors += batch_errors;
+    }
+
+    flushCacheModel(single);
+    flushCacheModel(batch);
+    checkCount("reads", batch->stats->reads, single->stats->reads);
+    checkCount("writes", batch->stats->writes, single->stats->writes);
+    checkCount("hits", batch->stats->hits, single->stats->hits);
+    checkCount("misses", batch->stats->misses, single->stats->misses);
+    checkCount("evictions", batch->stats->evictions, single->stats->evictions);
+    checkCount("write backs", batch->stats->write_backs, single->stats->write_backs);
+    if (batch->stats->hits == 0 || batch->stats->misses == 0 || total_errors == 0) {
+        printf("Accesses produced no hits, no misses or no errors\n");
+        exit(-1);
+    }
+    checkCount("memory reads", batch_mem->op_log->readTotal, single_mem->op_log->readTotal);
+    checkCount("memory writes", batch_mem->op_log->writeTotal, single_mem->op_log->writeTotal);
+    for (uint32_t address=0; address<(1 << ADDRESS_WIDTH); address+=4) {
+        uint32_t single_word;
+        uint32_t batch_word;
+        readWord(single_mem, address, &single_word);
+        readWord(batch_mem, address, &batch_word);
+        checkCount("memory word", batch_word, single_word);
+    }
+
+    // Empty batches do nothing, missing arrays are rejected
+    uint32_t errors = 1;
+    checkCount("empty batch", batch->read_bytes(batch->cache, NULL, NULL, 0, &errors), 0);
+    checkCount("empty batch errors", errors, 0);
+    if (batch->read_bytes(batch->cache, addresses, NULL, 1, NULL) == 0 ||
+        batch->write_bytes(batch->cache, NULL, values, 1, NULL) == 0) {
+        printf("Expected %s to reject a missing array\n", spec);
+        exit(-1);
+    }
+
+    freeCacheModel(single);
+    freeCacheModel(batch);
+    freeMainMem(single_mem);
+    freeMainMem(batch_mem);
+}
+
+int main() {
+    compareBatches("dm:4:2");
+    compareBatches("dm:4:2+through+noalloc");
+    compareBatches("fa:2:16");
+    compareBatches("fa:2:16:fifo");
+    compareBatches("sa:3:2:4");
+    compareBatches("sa:3:2:4:srrip+through");
+    compareBatches("sa:3:2:4+next");
+
+    // Fixed geometry caches (see sa_cache_fixed.h)
+    compareBatches("sa:6:2:4");
+    compareBatches("sa:6:2:4:plru+around");
+
+    printf("Batch Test 01 Finished\n");
+}
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "main_mem.h"
+#include "cache_model.h"
+
+// cache_bench
+//
+// Measures ns per access of the hit, miss and eviction paths of every
+// cache type over a sweep of geometries, and of MainMem's readWord,
+// writeWord and logOperation. Every loop runs warmup repetitions, which
+// are discarded, then repetitions that are timed one by one; the mean,
+// standard deviation, minimum and maximum ns per access are printed and,
+// with -o, written as JSON so builds can be compared.
+//
+// Cache loops, each over its own cache made write back, write allocate,
+// in front of a MainMem without a log:
+//   hit    reads of random bytes in half the cache's capacity
+//   miss   reads of one byte per block cycling over four times the capacity
+//   evict  writes of one byte per block cycling over four times the
+//          capacity, so each write misses and evicts a dirty line
+//   flush  writes of one byte per block of the capacity followed by
+//          flushCacheModel, which writes every line back
+//
+// Usage: cache_bench [-n accesses] [-r repetitions] [-w warmup] [-o json_file] [<cache_config>...]
+//        -n accesses per repetition (default 1048576)
+//        -r timed repetitions (default 5)
+//        -w untimed repetitions run first (default 1)
+//        cache_config is a single level dm, fa or sa configuration (see
+//        parseCacheConfig); the default sweep is listed in bench_configs
+
+#define BENCH_ADDRESS_WIDTH 24
+#define BENCH_TABLE_SIZE 65536
+#define BENCH_MEM_SPAN (1 << 20)
+
+static char *bench_configs[] = {
+    "dm:6:2", "dm:10:2", "dm:14:3",
+    "fa:2:16", "fa:2:64", "fa:2:256",
+    "sa:6:2:4", "sa:6:2:5", "sa:8:3:8", "sa:10:3:16",
+};
+
+typedef enum {BENCH_HIT, BENCH_MISS, BENCH_EVICT, BENCH_FLUSH} CacheLoop;
+
+static const char *cache_loop_names[] = {"hit", "miss", "evict", "flush"};
+
+typedef enum {BENCH_READ_WORD, BENCH_WRITE_WORD, BENCH_LOG_COUNTS, BENCH_LOG_FULL} MemLoop;
+
+static const char *mem_loop_names[] = {"readWord", "writeWord", "logOperation:counts", "logOperation:full"};
+
+// ns per access over the timed repetitions of one loop
+typedef struct BenchResult {
+    char target[CACHE_CONFIG_STR_LEN];
+    const char *loop;
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double hit_rate;            // Negative for MainMem loops
+} BenchResult;
+
+typedef struct BenchOptions {
+    uint64_t accesses;
+    uint32_t repetitions;
+    uint32_t warmup;
+} BenchOptions;
+
+// Keeps values read from being optimized away
+static volatile uint32_t bench_sink;
+
+static double elapsedSeconds(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-n accesses] [-r repetitions] [-w warmup] [-o json_file] [<cache_config>...]\n",
+            prog);
+    fprintf(stderr, "  cache_config: a single dm, fa or sa level, as for cachesim\n");
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Fills in mean, stddev, min and max of samples
+static void summarize(BenchResult *result, double *samples, uint32_t count) {
+    double sum = 0;
+    result->min = samples[0];
+    result->max = samples[0];
+    for (uint32_t i = 0; i < count; i++) {
+        sum += samples[i];
+        result->min = samples[i] < result->min ? samples[i] : result->min;
+        result->max = samples[i] > result->max ? samples[i] : result->max;
+    }
+    result->mean = sum / count;
+    double squares = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        squares += (samples[i] - result->mean) * (samples[i] - result->mean);
+    }
+    result->stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+}
+
+// Runs one repetition of loop over table, continuing from *position.
+// A flush repetition runs whole passes over table. Returns ns per access.
+static double runCacheLoop(CacheModel *model, CacheLoop loop, const uint32_t *table, uint32_t table_len,
+                           uint64_t accesses, uint32_t *position) {
+    struct timespec start, end;
+    uint64_t done = 0;
+    uint32_t sum = 0;
+    uint8_t value;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (loop == BENCH_FLUSH) {
+        while (done < accesses) {
+            for (uint32_t i = 0; i < table_len; i++) {
+                model->write_byte(model->cache, table[i], (uint8_t) i);
+            }
+            flushCacheModel(model);
+            done += table_len;
+        }
+    } else {
+        uint32_t p = *position;
+        for (; done < accesses; done++) {
+            if (loop == BENCH_EVICT) {
+                model->write_byte(model->cache, table[p], (uint8_t) done);
+            } else {
+                model->read_byte(model->cache, table[p], &value);
+                sum += value;
+            }
+            p = p + 1 == table_len ? 0 : p + 1;
+        }
+        *position = p;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    bench_sink = sum;
+    return elapsedSeconds(&start, &end) * 1e9 / done;
+}
+
+// Returns the addresses loop cycles over for a cache of capacity bytes
+// in blocks of block_bytes, setting *table_len
+static uint32_t *cacheLoopTable(CacheLoop loop, uint32_t capacity, uint32_t block_bytes, uint32_t *table_len) {
+    uint32_t blocks = capacity / block_bytes;
+    uint32_t state = 2463534242u;
+    if (loop == BENCH_HIT) {
+        *table_len = BENCH_TABLE_SIZE;
+    } else if (loop == BENCH_FLUSH) {
+        *table_len = blocks;
+    } else {
+        *table_len = 4 * blocks;
+    }
+    uint32_t *table = (uint32_t *) malloc(*table_len * sizeof(uint32_t));
+    for (uint32_t i = 0; table != NULL && i < *table_len; i++) {
+        table[i] = loop == BENCH_HIT ? nextRandom(&state) % (capacity / 2) : i * block_bytes;
+    }
+    return table;
+}
+
+// Measures loop on a fresh cache of config, given as spec. Returns 0 on
+// success.
+static int benchCache(char *spec, CacheConfig *config, CacheLoop loop, BenchOptions *options, BenchResult *result) {
+    uint32_t block_bytes = 4u << config->word_index_bitcount;
+    uint32_t lines = config->type == FA_CACHE_MODEL ? config->lines_per_set
+                                                    : config->lines_per_set << config->set_index_bitcount;
+    uint32_t table_len;
+    uint32_t *table = cacheLoopTable(loop, lines * block_bytes, block_bytes, &table_len);
+    MainMem *mem = createMainMem(BENCH_ADDRESS_WIDTH);
+    CacheModel *model = mem == NULL ? NULL : createCacheModel(mem, config);
+    double *samples = (double *) calloc(options->repetitions, sizeof(double));
+    int status = table == NULL || model == NULL || samples == NULL ? -1 : 0;
+
+    if (status == 0) {
+        setLogMode(mem->op_log, LOG_OFF);
+        uint32_t position = 0;
+        for (uint32_t i = 0; i < options->warmup; i++) {
+            runCacheLoop(model, loop, table, table_len, options->accesses, &position);
+        }
+        uint64_t hits = model->stats->hits;
+        uint64_t misses = model->stats->misses;
+        for (uint32_t i = 0; i < options->repetitions; i++) {
+            samples[i] = runCacheLoop(model, loop, table, table_len, options->accesses, &position);
+        }
+        hits = model->stats->hits - hits;
+        misses = model->stats->misses - misses;
+        snprintf(result->target, sizeof(result->target), "%s", spec);
+        result->loop = cache_loop_names[loop];
+        result->hit_rate = hits + misses > 0 ? (double) hits / (hits + misses) : 0;
+        summarize(result, samples, options->repetitions);
+    }
+
+    if (model != NULL) {
+        freeCacheModel(model);
+    }
+    if (mem != NULL) {
+        freeMainMem(mem);
+    }
+    free(table);
+    free(samples);
+    return status;
+}
+
+// Runs one repetition of loop over table. Returns ns per access.
+static double runMemLoop(MainMem *mem, MemLoop loop, const uint32_t *table, uint64_t accesses) {
+    struct timespec start, end;
+    uint32_t sum = 0;
+    uint32_t word;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < accesses; i++) {
+        uint32_t address = table[i & (BENCH_TABLE_SIZE - 1)];
+        if (loop == BENCH_READ_WORD) {
+            readWord(mem, address, &word);
+            sum += word;
+        } else if (loop == BENCH_WRITE_WORD) {
+            writeWord(mem, address, (uint32_t) i);
+        } else {
+            logOperation(mem->op_log, (i & 3) == 0 ? WRITE_OP : READ_OP, address >> 2, (uint32_t) i);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    bench_sink = sum;
+    return elapsedSeconds(&start, &end) * 1e9 / accesses;
+}
+
+// Measures loop on a fresh MainMem. Returns 0 on success.
+static int benchMainMem(MemLoop loop, BenchOptions *options, BenchResult *result) {
+    uint32_t *table = (uint32_t *) malloc(BENCH_TABLE_SIZE * sizeof(uint32_t));
+    MainMem *mem = createMainMem(BENCH_ADDRESS_WIDTH);
+    double *samples = (double *) calloc(options->repetitions, sizeof(double));
+    int status = table == NULL || mem == NULL || samples == NULL ? -1 : 0;
+
+    if (status == 0) {
+        uint32_t state = 88675123u;
+        for (uint32_t i = 0; i < BENCH_TABLE_SIZE; i++) {
+            table[i] = nextRandom(&state) % BENCH_MEM_SPAN & ~3u;
+        }
+        setLogMode(mem->op_log, loop == BENCH_LOG_FULL ? LOG_FULL : loop == BENCH_LOG_COUNTS ? LOG_COUNTS_ONLY : LOG_OFF);
+        for (uint32_t i = 0; i < options->warmup + options->repetitions; i++) {
+            double ns = runMemLoop(mem, loop, table, options->accesses);
+            if (i >= options->warmup) {
+                samples[i - options->warmup] = ns;
+            }
+            clearLog(mem->op_log);
+        }
+        strcpy(result->target, "mainmem");
+        result->loop = mem_loop_names[loop];
+        result->hit_rate = -1;
+        summarize(result, samples, options->repetitions);
+    }
+
+    if (mem != NULL) {
+        freeMainMem(mem);
+    }
+    free(table);
+    free(samples);
+    return status;
+}
+
+static void printResult(BenchResult *result) {
+    printf("%-14s %-20s %10.2f %8.2f %10.2f %10.2f", result->target, result->loop, result->mean,
+           result->stddev, result->min, result->max);
+    if (result->hit_rate >= 0) {
+        printf(" %9.5f", result->hit_rate);
+    }
+    printf("\n");
+}
+
+static void writeJson(FILE *file, BenchOptions *options, BenchResult *results, uint32_t count) {
+    fprintf(file, "{\n  \"accesses\": %llu,\n  \"repetitions\": %u,\n  \"warmup\": %u,\n  \"results\": [\n",
+            (unsigned long long) options->accesses, options->repetitions, options->warmup);
+    for (uint32_t i = 0; i < count; i++) {
+        BenchResult *result = &results[i];
+        fprintf(file, "    {\"target\": \"%s\", \"loop\": \"%s\", \"ns_per_access\": %.3f, \"stddev\": %.3f, "
+                "\"min\": %.3f, \"max\": %.3f", result->target, result->loop, result->mean, result->stddev,
+                result->min, result->max);
+        if (result->hit_rate >= 0) {
+            fprintf(file, ", \"hit_rate\": %.6f", result->hit_rate);
+        }
+        fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options = {1 << 20, 5, 1};
+    char *json_file = NULL;
+    int argi = 1;
+
+    while (argi + 1 < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-n") == 0) {
+            options.accesses = strtoull(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "-r") == 0) {
+            options.repetitions = (uint32_t) strtoul(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "-w") == 0) {
+            options.warmup = (uint32_t) strtoul(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "-o") == 0) {
+            json_file = argv[argi + 1];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        argi += 2;
+    }
+    if (options.accesses == 0 || options.repetitions == 0 || (argi < argc && argv[argi][0] == '-')) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char **specs = argi < argc ? &argv[argi] : bench_configs;
+    uint32_t num_specs = argi < argc ? (uint32_t) (argc - argi) : sizeof(bench_configs) / sizeof(bench_configs[0]);
+    CacheConfig *configs = (CacheConfig *) calloc(num_specs, sizeof(CacheConfig));
+    for (uint32_t i = 0; configs != NULL && i < num_specs; i++) {
+        CacheConfig *config = &configs[i];
+        if (parseCacheConfig(specs[i], config) != 0 || config->num_lower != 0 ||
+            config->prefetch.type != PREFETCH_NONE || config->write_buffer_entries != 0) {
+            fprintf(stderr, "unsupported cache configuration %s\n", specs[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        // Four times the capacity must fit in MainMem for the miss loops
+        uint32_t lines = config->type == FA_CACHE_MODEL ? config->lines_per_set
+                                                        : config->lines_per_set << config->set_index_bitcount;
+        if ((uint64_t) lines << (config->word_index_bitcount + 4) > (1u << BENCH_ADDRESS_WIDTH)) {
+            fprintf(stderr, "cache configuration %s is too large\n", specs[i]);
+            return 1;
+        }
+        config->write_policy.hit = WRITE_HIT_BACK;
+        config->write_policy.miss = WRITE_MISS_ALLOCATE;
+    }
+
+    uint32_t max_results = num_specs * 4 + 4;
+    BenchResult *results = (BenchResult *) calloc(max_results, sizeof(BenchResult));
+    if (configs == NULL || results == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("%llu accesses per repetition, %u repetitions after %u warmup, ns per access\n",
+           (unsigned long long) options.accesses, options.repetitions, options.warmup);
+    printf("%-14s %-20s %10s %8s %10s %10s %9s\n", "target", "loop", "mean", "stddev", "min", "max", "hit_rate");
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < num_specs; i++) {
+        for (CacheLoop loop = BENCH_HIT; loop <= BENCH_FLUSH; loop++) {
+            if (benchCache(specs[i], &configs[i], loop, &options, &results[count]) != 0) {
+                fprintf(stderr, "cannot create cache %s\n", specs[i]);
+                return 1;
+            }
+            printResult(&results[count++]);
+        }
+    }
+    for (MemLoop loop = BENCH_READ_WORD; loop <= BENCH_LOG_FULL; loop++) {
+        if (benchMainMem(loop, &options, &results[count]) != 0) {
+            fprintf(stderr, "cannot create MainMem\n");
+            return 1;
+        }
+        printResult(&results[count++]);
+    }
+
+    int status = 0;
+    if (json_file != NULL) {
+        FILE *file = fopen(json_file, "w");
+        if (file == NULL) {
+            fprintf(stderr, "cannot write %s\n", json_file);
+            status = 1;
+        } else {
+            writeJson(file, &options, results, count);
+            fclose(file);
+        }
+    }
+    free(configs);
+    free(results);
+    return status;
+}
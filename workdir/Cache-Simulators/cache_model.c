@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache_model.h"
+
+WritePolicy defaultWritePolicy(CacheModelType type) {
+    WritePolicy policy = {WRITE_HIT_THROUGH, WRITE_MISS_ALLOCATE};
+    if (type == DM_CACHE_MODEL) {
+        policy.miss = WRITE_MISS_NO_ALLOCATE;
+    } else if (type == SA_CACHE_MODEL) {
+        policy.hit = WRITE_HIT_BACK;
+    }
+    return policy;
+}
+
+// Parses one level of a configuration string (see cache_model.h)
+static int parseLevel(char *spec, CacheLevelConfig *level) {
+    uint32_t a, b, c;
+    char tail;
+    int used = 0;
+
+    level->policy = REPL_LRU;
+    memset(&level->prefetch, 0, sizeof(level->prefetch));
+    level->write_buffer_entries = 0;
+    level->classify_misses = 0;
+    level->sector_words = 0;
+    if (strncmp(spec, "dm:", 3) == 0) {
+        level->type = DM_CACHE_MODEL;
+    } else if (strncmp(spec, "fa:", 3) == 0) {
+        level->type = FA_CACHE_MODEL;
+    } else if (strncmp(spec, "sa:", 3) == 0) {
+        level->type = SA_CACHE_MODEL;
+    } else {
+        return -1;
+    }
+    level->write_policy = defaultWritePolicy(level->type);
+
+    // Write policy, miss classification and sector suffixes, then at most
+    // one prefetcher (SA) or write buffer (FA)
+    char *plus = strchr(spec, '+');
+    while (plus != NULL) {
+        *plus = '\0';
+        char *suffix = plus + 1;
+        plus = strchr(suffix, '+');
+        if (plus != NULL) {
+            *plus = '\0';
+        }
+        if (parseWritePolicy(suffix, &level->write_policy) == 0) {
+            continue;
+        }
+        if (strcmp(suffix, "3c") == 0 && level->type != FA_CACHE_MODEL) {
+            level->classify_misses = 1;
+            continue;
+        }
+        if (strncmp(suffix, "sector:", 7) == 0 && level->type == SA_CACHE_MODEL && level->sector_words == 0) {
+            if (sscanf(suffix + 7, "%u%c", &level->sector_words, &tail) != 1 || level->sector_words == 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (level->type == SA_CACHE_MODEL && level->prefetch.type == PREFETCH_NONE) {
+            if (parsePrefetchConfig(suffix, &level->prefetch) != 0) {
+                return -1;
+            }
+        } else if (level->type == FA_CACHE_MODEL && level->write_buffer_entries == 0) {
+            if (sscanf(suffix, "wb:%u%c", &level->write_buffer_entries, &tail) != 1 ||
+                level->write_buffer_entries == 0) {
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+    }
+
+    if (level->type == DM_CACHE_MODEL) {
+        if (sscanf(spec + 3, "%u:%u%c", &a, &b, &tail) != 2) {
+            return -1;
+        }
+        level->set_index_bitcount = a;
+        level->word_index_bitcount = b;
+        level->lines_per_set = 1;
+        return 0;
+    } else if (level->type == FA_CACHE_MODEL) {
+        if (sscanf(spec + 3, "%u:%u%n", &a, &b, &used) != 2) {
+            return -1;
+        }
+        level->set_index_bitcount = 0;
+        level->word_index_bitcount = a;
+        level->lines_per_set = b;
+    } else {
+        if (sscanf(spec + 3, "%u:%u:%u%n", &a, &b, &c, &used) != 3) {
+            return -1;
+        }
+        level->set_index_bitcount = a;
+        level->word_index_bitcount = b;
+        level->lines_per_set = c;
+    }
+
+    // Optional replacement policy suffix
+    char *rest = spec + 3 + used;
+    if (*rest == '\0') {
+        return 0;
+    }
+    if (*rest != ':' || parseReplacementType(rest + 1, &level->policy) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Writes one level of a configuration string at buffer of size (at least
+// 1) bytes, truncating it to fit, and returns the length written
+static int formatLevel(CacheLevelConfig *level, char *buffer, size_t size) {
+    WritePolicy write_default = defaultWritePolicy(level->type);
+    int len = 0;
+    switch (level->type) {
+        case DM_CACHE_MODEL:
+            len = snprintf(buffer, size, "dm:%u:%u",
+                           level->set_index_bitcount, level->word_index_bitcount);
+            break;
+        case FA_CACHE_MODEL:
+            len = snprintf(buffer, size, "fa:%u:%u",
+                           level->word_index_bitcount, level->lines_per_set);
+            break;
+        case SA_CACHE_MODEL:
+            len = snprintf(buffer, size, "sa:%u:%u:%u",
+                           level->set_index_bitcount, level->word_index_bitcount,
+                           level->lines_per_set);
+            break;
+    }
+    if (level->policy != REPL_LRU && len >= 0 && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, ":%s", replacementTypeName(level->policy));
+    }
+    if (level->write_policy.hit != write_default.hit && len >= 0 && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, "+%s", writeHitPolicyName(level->write_policy.hit));
+    }
+    if (level->write_policy.miss != write_default.miss && len >= 0 && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, "+%s", writeMissPolicyName(level->write_policy.miss));
+    }
+    if (level->classify_misses && len >= 0 && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, "+3c");
+    }
+    if (level->prefetch.type != PREFETCH_NONE && len >= 0 && (size_t) len + 1 < size) {
+        buffer[len++] = '+';
+        len += formatPrefetchConfig(&level->prefetch, buffer + len, size - len);
+    }
+    if (level->write_buffer_entries != 0 && len >= 0 && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, "+wb:%u", level->write_buffer_entries);
+    }
+    if (level->sector_words != 0 && len >= 0 && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, "+sector:%u", level->sector_words);
+    }
+    if (len < 0) {
+        buffer[0] = '\0';
+        return 0;
+    }
+    return (size_t) len < size ? len : (int) size - 1;
+}
+
+static void getLevel(CacheConfig *config, CacheLevelConfig *level) {
+    level->type = config->type;
+    level->set_index_bitcount = config->set_index_bitcount;
+    level->word_index_bitcount = config->word_index_bitcount;
+    level->lines_per_set = config->lines_per_set;
+    level->policy = config->policy;
+    level->prefetch = config->prefetch;
+    level->write_buffer_entries = config->write_buffer_entries;
+    level->write_policy = config->write_policy;
+    level->classify_misses = config->classify_misses;
+    level->sector_words = config->sector_words;
+}
+
+static void setLevel(CacheConfig *config, CacheLevelConfig *level) {
+    config->type = level->type;
+    config->set_index_bitcount = level->set_index_bitcount;
+    config->word_index_bitcount = level->word_index_bitcount;
+    config->lines_per_set = level->lines_per_set;
+    config->policy = level->policy;
+    config->prefetch = level->prefetch;
+    config->write_buffer_entries = level->write_buffer_entries;
+    config->write_policy = level->write_policy;
+    config->classify_misses = level->classify_misses;
+    config->sector_words = level->sector_words;
+    config->num_lower = 0;
+    config->inclusion = INCLUSION_NON_INCLUSIVE;
+}
+
+//----------------------
+// parseCacheConfig
+//
+// Arguments: spec - configuration string (see cache_model.h)
+//            config - pointer to CacheConfig to fill in
+//
+// Results: 0 and config updated on success, -1 if spec is malformed.
+//
+int parseCacheConfig(char *spec, CacheConfig *config) {
+    if (spec == NULL || config == NULL) {
+        return -1;
+    }
+
+    char buffer[CACHE_CONFIG_STR_LEN];
+    if (strlen(spec) >= sizeof(buffer)) {
+        return -1;
+    }
+    strcpy(buffer, spec);
+
+    InclusionPolicy inclusion = INCLUSION_NON_INCLUSIVE;
+    char *comma = strchr(buffer, ',');
+    if (comma != NULL) {
+        *comma = '\0';
+        if (parseInclusionPolicy(comma + 1, &inclusion) != 0) {
+            return -1;
+        }
+    }
+
+    CacheLevelConfig levels[CACHE_MAX_LEVELS];
+    uint32_t num_levels = 0;
+    char *level_spec = buffer;
+    for (;;) {
+        char *slash = strchr(level_spec, '/');
+        if (slash != NULL) {
+            *slash = '\0';
+        }
+        if (num_levels == CACHE_MAX_LEVELS || parseLevel(level_spec, &levels[num_levels]) != 0) {
+            return -1;
+        }
+        CacheLevelConfig *level = &levels[num_levels];
+        if (level->sector_words != 0 && (level->classify_misses || level->prefetch.type != PREFETCH_NONE ||
+                                         inclusion == INCLUSION_EXCLUSIVE)) {
+            return -1;
+        }
+        num_levels++;
+        if (slash == NULL) {
+            break;
+        }
+        level_spec = slash + 1;
+    }
+
+    setLevel(config, &levels[0]);
+    config->num_lower = num_levels - 1;
+    config->inclusion = inclusion;
+    for (uint32_t i = 1; i < num_levels; i++) {
+        config->lower[i - 1] = levels[i];
+    }
+    return 0;
+}
+
+//----------------------
+// formatCacheConfig
+//
+// Arguments: config - pointer to CacheConfig
+//            buffer - buffer of at least CACHE_CONFIG_STR_LEN bytes
+//
+// Results: None. buffer holds the configuration string that
+//          parseCacheConfig would accept for config. Policy and
+//          inclusion suffixes are omitted for the defaults. A longer
+//          string is truncated to CACHE_CONFIG_STR_LEN - 1 characters.
+//
+void formatCacheConfig(CacheConfig *config, char *buffer) {
+    CacheLevelConfig level;
+    getLevel(config, &level);
+    size_t len = formatLevel(&level, buffer, CACHE_CONFIG_STR_LEN);
+
+    // A '/' goes in only with room for the terminator after it
+    for (uint32_t i = 0; i < config->num_lower && len + 1 < CACHE_CONFIG_STR_LEN; i++) {
+        buffer[len++] = '/';
+        len += formatLevel(&config->lower[i], buffer + len, CACHE_CONFIG_STR_LEN - len);
+    }
+    if (config->num_lower > 0 && config->inclusion != INCLUSION_NON_INCLUSIVE &&
+        len + 1 < CACHE_CONFIG_STR_LEN) {
+        snprintf(buffer + len, CACHE_CONFIG_STR_LEN - len, ",%s",
+                 inclusionPolicyName(config->inclusion));
+    }
+}
+
+// Creates model of a single cache described by the first level of config
+static CacheModel *createLevelModel(MainMem *mem, CacheConfig *config) {
+    switch (config->type) {
+        case DM_CACHE_MODEL:
+            return createDMCacheModel(mem, config);
+        case FA_CACHE_MODEL:
+            return createFACacheModel(mem, config);
+        case SA_CACHE_MODEL:
+            return createSACacheModel(mem, config);
+    }
+    return NULL;
+}
+
+//----------------------
+// createCacheModel
+//
+// Arguments: mem - MainMem the cache sits in front of
+//            config - geometry of cache (or hierarchy) to create
+//
+// Results: Pointer to CacheModel wrapping newly created cache,
+//          NULL on error. For a hierarchy the model wraps the first
+//          level and owns the models of the levels below it.
+//
+CacheModel *createCacheModel(MainMem *mem, CacheConfig *config) {
+    if (mem == NULL || config == NULL || config->num_lower >= CACHE_MAX_LEVELS) {
+        return NULL;
+    }
+
+    CacheModel *model = createLevelModel(mem, config);
+    if (model == NULL) {
+        return NULL;
+    }
+
+    CacheModel *upper = model;
+    for (uint32_t i = 0; i < config->num_lower; i++) {
+        CacheConfig level;
+        setLevel(&level, &config->lower[i]);
+        CacheModel *lower = createLevelModel(mem, &level);
+        if (lower == NULL || linkBackingStores(upper->store, lower->store, config->inclusion) != 0) {
+            freeCacheModel(lower);
+            freeCacheModel(model);
+            return NULL;
+        }
+        upper->lower = lower;
+        upper = lower;
+    }
+
+    model->config = *config;
+    return model;
+}
+
+//----------------------
+// freeCacheModel
+//
+// Arguments: model - pointer to CacheModel to free
+//
+// Results: None. Underlying cache, lower levels and model are free'd.
+//
+void freeCacheModel(CacheModel *model) {
+    while (model != NULL) {
+        CacheModel *lower = model->lower;
+        model->free_cache(model->cache);
+        free(model);
+        model = lower;
+    }
+}
+
+//----------------------
+// flushCacheModel
+//
+// Arguments: model - pointer to CacheModel to flush
+//
+// Results: None. Each level with a flush operation is flushed, first
+//          level first, so dirty data drains down to MainMem.
+//
+void flushCacheModel(CacheModel *model) {
+    for (; model != NULL; model = model->lower) {
+        if (model->flush != NULL) {
+            model->flush(model->cache);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef CACHE_MODEL_H
+#define CACHE_MODEL_H
+#include <stdint.h>
+#include "main_mem.h"
+#include "replacement.h"
+#include "prefetch.h"
+#include "write_buffer.h"
+#include "backing_store.h"
+#include "cache_stats.h"
+
+// CacheModel
+//
+// Uniform handle over the DMCache, FACache and SACache simulators so that
+// drivers can replay traces through any of them. Each cache type keeps its
+// own readByte/writeByte and readBytes/writeBytes declarations; the
+// adapters in dm_cache_model.c, fa_cache_model.c and sa_cache_model.c are
+// compiled against namespaced copies of the cache objects (see Makefile)
+// so all three can be linked into one program.
+//
+// A configuration may describe a hierarchy of up to CACHE_MAX_LEVELS
+// caches. The model then wraps the first level, with each level stacked
+// on the next through its BackingStore and the last one on MainMem.
+
+typedef enum {DM_CACHE_MODEL, FA_CACHE_MODEL, SA_CACHE_MODEL} CacheModelType;
+
+// Maximum number of levels in a cache hierarchy
+#define CACHE_MAX_LEVELS 4
+
+// Geometry of one level below the first of a hierarchy
+typedef struct CacheLevelConfig {
+    CacheModelType type;
+    uint32_t set_index_bitcount;
+    uint32_t word_index_bitcount;
+    uint32_t lines_per_set;
+    ReplacementType policy;
+    PrefetchConfig prefetch;
+    uint32_t write_buffer_entries;
+    WritePolicy write_policy;
+    uint32_t classify_misses;
+    uint32_t sector_words;
+} CacheLevelConfig;
+
+// Cache geometry as parsed from a configuration string
+typedef struct CacheConfig {
+    CacheModelType type;
+    uint32_t set_index_bitcount;    // Unused for FA
+    uint32_t word_index_bitcount;
+    uint32_t lines_per_set;         // Number of lines for FA, ways for SA, 1 for DM
+    ReplacementType policy;         // REPL_LRU for DM
+    PrefetchConfig prefetch;        // type PREFETCH_NONE unless SA with a prefetcher
+    uint32_t write_buffer_entries;  // Coalescing write buffer size, 0 for none (FA only)
+    WritePolicy write_policy;       // defaultWritePolicy(type) unless given
+    uint32_t classify_misses;       // Non-zero to classify misses (DM and SA only, see miss_class.h)
+    uint32_t sector_words;          // Words per sector of a sectored cache, 0 for none (SA only)
+    uint32_t num_lower;             // Levels below this one, 0 for a single cache
+    InclusionPolicy inclusion;      // Applies to every link of the hierarchy
+    CacheLevelConfig lower[CACHE_MAX_LEVELS - 1];
+} CacheConfig;
+
+typedef struct CacheModel {
+    CacheConfig config;
+    MainMem *mem;
+    void *cache;
+    // Each returns 0 on success or the cache specific error code
+    int (*read_byte)(void *cache, uint32_t address, uint8_t *value);
+    int (*write_byte)(void *cache, uint32_t address, uint8_t value);    // NULL if read-only
+    // Batched forms, performing count accesses in order (see readBytes in
+    // each cache's header). errors receives the number that failed.
+    int (*read_bytes)(void *cache, const uint32_t *addresses, uint8_t *values, uint32_t count, uint32_t *errors);
+    int (*write_bytes)(void *cache, const uint32_t *addresses, const uint8_t *values, uint32_t count,
+                       uint32_t *errors);                              // NULL if read-only
+    void (*flush)(void *cache);                                        // NULL if not supported
+    void (*free_cache)(void *cache);
+    BackingStore *store;            // The cache's store, for stacking
+    CacheStats *stats;              // The cache's counters
+    PrefetchStats *prefetch_stats;  // NULL if the cache has no prefetcher
+    WriteBufferStats *write_buffer_stats;   // NULL if the cache has no write buffer
+    struct CacheModel *lower;       // Model of the next level, NULL for the last one
+} CacheModel;
+
+// Maximum length of string produced by formatCacheConfig
+#define CACHE_CONFIG_STR_LEN 128
+
+// Parses configuration string of the form
+//     <level>[/<level>...][,<inclusion>]
+// listing levels from the one nearest the CPU down, where each level is
+//     dm:<set_index_bits>:<word_index_bits>[+<write>...][+3c]
+//     fa:<word_index_bits>:<num_lines>[:<policy>][+<write>...][+wb:<entries>]
+//     sa:<set_index_bits>:<word_index_bits>:<lines_per_set>[:<policy>][+<write>...][+3c][+<prefetcher>]
+//        [+sector:<words>]
+// policy is a name accepted by parseReplacementType (default lru),
+// write a name accepted by parseWritePolicy (default defaultWritePolicy),
+// prefetcher a string accepted by parsePrefetchConfig, entries the size
+// of a coalescing write buffer and inclusion a name accepted by
+// parseInclusionPolicy (default nine). 3c turns on miss classification.
+// sector makes the cache sectored (see enableSASectors), which rules out
+// 3c, a prefetcher and an exclusive hierarchy.
+// Returns 0 on success, -1 if the string is malformed.
+int parseCacheConfig(char *spec, CacheConfig *config);
+
+// Returns write policy of a cache of type unless one is given: write
+// through, no write allocate for DM, write through, write allocate for FA
+// and write back, write allocate for SA
+WritePolicy defaultWritePolicy(CacheModelType type);
+
+// Writes configuration string for config into buffer of CACHE_CONFIG_STR_LEN bytes
+void formatCacheConfig(CacheConfig *config, char *buffer);
+
+// Creates cache described by config in front of mem. Returns NULL on error.
+CacheModel *createCacheModel(MainMem *mem, CacheConfig *config);
+
+// Frees cache model, underlying cache and any lower levels
+void freeCacheModel(CacheModel *model);
+
+// Flushes every level of model that supports flushing, top down
+void flushCacheModel(CacheModel *model);
+
+// Per type constructors used by createCacheModel
+CacheModel *createDMCacheModel(MainMem *mem, CacheConfig *config);
+CacheModel *createFACacheModel(MainMem *mem, CacheConfig *config);
+CacheModel *createSACacheModel(MainMem *mem, CacheConfig *config);
+
+#endif
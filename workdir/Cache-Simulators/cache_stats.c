@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cache_stats.h"
+
+int initCacheStats(CacheStats *stats, uint32_t num_sets) {
+    memset(stats, 0, sizeof(CacheStats));
+    stats->num_sets = num_sets;
+    stats->set_hits = (uint64_t *) calloc(num_sets, sizeof(uint64_t));
+    stats->set_misses = (uint64_t *) calloc(num_sets, sizeof(uint64_t));
+    stats->set_evictions = (uint64_t *) calloc(num_sets, sizeof(uint64_t));
+    if (stats->set_hits == NULL || stats->set_misses == NULL || stats->set_evictions == NULL) {
+        freeCacheStats(stats);
+        return -1;
+    }
+    return 0;
+}
+
+void freeCacheStats(CacheStats *stats) {
+    free(stats->set_hits);
+    free(stats->set_misses);
+    free(stats->set_evictions);
+    stats->set_hits = NULL;
+    stats->set_misses = NULL;
+    stats->set_evictions = NULL;
+}
+
+void resetCacheStats(CacheStats *stats) {
+    stats->reads = 0;
+    stats->writes = 0;
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->fills = 0;
+    stats->evictions = 0;
+    stats->write_backs = 0;
+    stats->invalidations = 0;
+    stats->compulsory_misses = 0;
+    stats->capacity_misses = 0;
+    stats->conflict_misses = 0;
+    memset(stats->set_hits, 0, stats->num_sets * sizeof(uint64_t));
+    memset(stats->set_misses, 0, stats->num_sets * sizeof(uint64_t));
+    memset(stats->set_evictions, 0, stats->num_sets * sizeof(uint64_t));
+}
+
+int copyCacheStats(CacheStats *dst, CacheStats *src) {
+    if (initCacheStats(dst, src->num_sets) != 0) {
+        return -1;
+    }
+    uint64_t *set_hits = dst->set_hits;
+    uint64_t *set_misses = dst->set_misses;
+    uint64_t *set_evictions = dst->set_evictions;
+    *dst = *src;
+    dst->set_hits = set_hits;
+    dst->set_misses = set_misses;
+    dst->set_evictions = set_evictions;
+    memcpy(dst->set_hits, src->set_hits, src->num_sets * sizeof(uint64_t));
+    memcpy(dst->set_misses, src->set_misses, src->num_sets * sizeof(uint64_t));
+    memcpy(dst->set_evictions, src->set_evictions, src->num_sets * sizeof(uint64_t));
+    return 0;
+}
+
+static void writeArray(FILE *file, const char *name, uint64_t *values, uint32_t count) {
+    fprintf(file, ", \"%s\": [", name);
+    for (uint32_t i = 0; i < count; i++) {
+        fprintf(file, i == 0 ? "%llu" : ", %llu", (unsigned long long) values[i]);
+    }
+    fprintf(file, "]");
+}
+
+//----------------------
+// writeCacheStatsJSON
+//
+// Arguments: file - stream to write to
+//            stats - counters to write
+//            config - configuration string of the cache (see cache_model.h)
+//            level - level of the cache within config, 1 for L1
+//
+// Results: None. One JSON object is written, holding the totals, the
+//          hit rate, the miss classes and per set hit, miss and
+//          eviction arrays.
+//          config is written as is, so it must not need escaping.
+//
+void writeCacheStatsJSON(FILE *file, CacheStats *stats, const char *config, uint32_t level) {
+    uint64_t accesses = stats->hits + stats->misses;
+    fprintf(file, "{\"config\": \"%s\", \"level\": %u, \"accesses\": %llu, \"reads\": %llu, "
+            "\"writes\": %llu, \"hits\": %llu, \"misses\": %llu, \"hit_rate\": %.6f, \"fills\": %llu, "
+            "\"evictions\": %llu, \"write_backs\": %llu, \"invalidations\": %llu, "
+            "\"compulsory_misses\": %llu, \"capacity_misses\": %llu, \"conflict_misses\": %llu, \"sets\": %u",
+            config, level, (unsigned long long) accesses, (unsigned long long) stats->reads,
+            (unsigned long long) stats->writes, (unsigned long long) stats->hits,
+            (unsigned long long) stats->misses, accesses > 0 ? (double) stats->hits / accesses : 0.0,
+            (unsigned long long) stats->fills, (unsigned long long) stats->evictions,
+            (unsigned long long) stats->write_backs, (unsigned long long) stats->invalidations,
+            (unsigned long long) stats->compulsory_misses, (unsigned long long) stats->capacity_misses,
+            (unsigned long long) stats->conflict_misses, stats->num_sets);
+    writeArray(file, "set_hits", stats->set_hits, stats->num_sets);
+    writeArray(file, "set_misses", stats->set_misses, stats->num_sets);
+    writeArray(file, "set_evictions", stats->set_evictions, stats->num_sets);
+    fprintf(file, "}");
+}
+
+void writeCacheStatsCSVHeader(FILE *file) {
+    fprintf(file, "config,level,set,accesses,reads,writes,hits,misses,fills,evictions,write_backs,invalidations,"
+            "compulsory_misses,capacity_misses,conflict_misses\n");
+}
+
+void writeCacheStatsCSV(FILE *file, CacheStats *stats, const char *config, uint32_t level) {
+    fprintf(file, "\"%s\",%u,all,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", config, level,
+            (unsigned long long) (stats->hits + stats->misses), (unsigned long long) stats->reads,
+            (unsigned long long) stats->writes, (unsigned long long) stats->hits,
+            (unsigned long long) stats->misses, (unsigned long long) stats->fills,
+            (unsigned long long) stats->evictions, (unsigned long long) stats->write_backs,
+            (unsigned long long) stats->invalidations, (unsigned long long) stats->compulsory_misses,
+            (unsigned long long) stats->capacity_misses, (unsigned long long) stats->conflict_misses);
+    for (uint32_t i = 0; i < stats->num_sets; i++) {
+        fprintf(file, "\"%s\",%u,%u,%llu,,,%llu,%llu,,%llu,,,,,\n", config, level, i,
+                (unsigned long long) (stats->set_hits[i] + stats->set_misses[i]),
+                (unsigned long long) stats->set_hits[i], (unsigned long long) stats->set_misses[i],
+                (unsigned long long) stats->set_evictions[i]);
+    }
+}
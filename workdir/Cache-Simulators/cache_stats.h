@@ -0,0 +1,94 @@
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+#include <stdint.h>
+#include <stdio.h>
+
+// CacheStats
+//
+// Event counters kept by every DMCache, FACache and SACache. Counting is
+// a few increments per access, so the counters are always on.
+//
+// An access is a readByte/writeByte or a block read or written by the
+// level above; each is one hit or one miss of the set it maps to. Blocks
+// moved for other reasons (prefetches, clean victims inserted into an
+// exclusive level) are not accesses but still count as fills.
+//
+// The three miss class counters stay zero unless the cache classifies
+// its misses (miss_class.h).
+//
+// Counters can be written out as one JSON object or as CSV rows, a
+// totals row followed by one row per set.
+
+typedef struct CacheStats {
+    uint32_t num_sets;
+    uint64_t reads;             // Read accesses
+    uint64_t writes;            // Write accesses
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t fills;             // Lines (sectors of a sectored SACache) filled from the level below
+    uint64_t evictions;         // Valid lines replaced or written around
+    uint64_t write_backs;       // Dirty blocks written to the level below
+    uint64_t invalidations;     // Lines dropped or handed up at the request of another level
+    uint64_t compulsory_misses; // Misses classified by a MissClassifier
+    uint64_t capacity_misses;
+    uint64_t conflict_misses;
+    uint64_t *set_hits;         // num_sets per set counters
+    uint64_t *set_misses;
+    uint64_t *set_evictions;
+} CacheStats;
+
+// Kinds of lookup passed to countAccess
+typedef enum {STATS_NO_ACCESS, STATS_READ, STATS_WRITE} StatsAccess;
+
+// Zeroes stats and allocates its per set counters. Returns 0 on success,
+// -1 on allocation failure, leaving stats safe to pass to freeCacheStats.
+int initCacheStats(CacheStats *stats, uint32_t num_sets);
+
+// Frees the per set counters of stats (not stats itself)
+void freeCacheStats(CacheStats *stats);
+
+// Zeroes every counter of stats
+void resetCacheStats(CacheStats *stats);
+
+// Initializes dst as a copy of src. Returns 0 on success, -1 on
+// allocation failure. dst is freed with freeCacheStats.
+int copyCacheStats(CacheStats *dst, CacheStats *src);
+
+// Counts a hit or miss in set for a lookup of kind access
+static inline void countAccess(CacheStats *stats, uint32_t set, StatsAccess access, int hit) {
+    if (access == STATS_NO_ACCESS) {
+        return;
+    }
+    if (access == STATS_READ) {
+        stats->reads++;
+    } else {
+        stats->writes++;
+    }
+    if (hit) {
+        stats->hits++;
+        stats->set_hits[set]++;
+    } else {
+        stats->misses++;
+        stats->set_misses[set]++;
+    }
+}
+
+// Counts a line of set evicted
+static inline void countEviction(CacheStats *stats, uint32_t set) {
+    stats->evictions++;
+    stats->set_evictions[set]++;
+}
+
+// Writes stats to file as a JSON object labelled with config and level
+// (1 for the level nearest the CPU), without a trailing newline
+void writeCacheStatsJSON(FILE *file, CacheStats *stats, const char *config, uint32_t level);
+
+// Writes the header row matching writeCacheStatsCSV
+void writeCacheStatsCSVHeader(FILE *file);
+
+// Writes stats to file as CSV rows labelled with config (quoted) and
+// level: a totals row with set "all", then a row per set with only accesses,
+// hits, misses and evictions filled in
+void writeCacheStatsCSV(FILE *file, CacheStats *stats, const char *config, uint32_t level);
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main_mem.h"
+#include "cache_model.h"
+#include "test_util.h"
+
+#define ADDRESS_WIDTH 12
+
+static void expect(char *spec, char *name, uint64_t actual, uint64_t expected) {
+    if (actual != expected) {
+        printf("%s counted %llu %s, expected %llu\n", spec, (unsigned long long) actual, name,
+               (unsigned long long) expected);
+        exit(-1);
+    }
+}
+
+// Reads bytes 0x00, 0x40, 0x80 and 0x00 again, then writes 0x41. With
+// 4 sets of 16 byte blocks all three blocks map to set 0.
+static void runPattern(CacheModel *model) {
+    readOrExit(model, 0x00);
+    readOrExit(model, 0x40);
+    readOrExit(model, 0x80);
+    readOrExit(model, 0x00);
+    writeOrExit(model, 0x41, 1);
+}
+
+int main() {
+    MainMem *main_mem = createMainMem(ADDRESS_WIDTH);
+
+    // Direct mapped: every block of set 0 replaces the last one
+    CacheModel *model = createModel("dm:2:2+back+alloc", main_mem);
+    runPattern(model);
+    CacheStats *stats = model->stats;
+    expect("dm", "reads", stats->reads, 4);
+    expect("dm", "writes", stats->writes, 1);
+    expect("dm", "hits", stats->hits, 0);
+    expect("dm", "misses", stats->misses, 5);
+    expect("dm", "fills", stats->fills, 5);
+    expect("dm", "evictions", stats->evictions, 4);
+    expect("dm", "set 0 misses", stats->set_misses[0], 5);
+    expect("dm", "set 1 misses", stats->set_misses[1], 0);
+    flushCacheModel(model);
+    expect("dm", "write backs", stats->write_backs, 1);
+    freeCacheModel(model);
+
+    // Two way LRU: 0x00 is evicted by 0x80, then 0x40 by 0x00
+    model = createModel("sa:2:2:2+back", main_mem);
+    runPattern(model);
+    stats = model->stats;
+    expect("sa", "hits", stats->hits, 0);
+    expect("sa", "misses", stats->misses, 5);
+    expect("sa", "evictions", stats->evictions, 3);
+    expect("sa", "set 0 evictions", stats->set_evictions[0], 3);
+    flushCacheModel(model);
+    expect("sa", "write backs", stats->write_backs, 1);
+
+    resetCacheStats(stats);
+    expect("sa", "misses after reset", stats->misses, 0);
+    expect("sa", "set 0 misses after reset", stats->set_misses[0], 0);
+    freeCacheModel(model);
+
+    // Fully associative: everything fits, so only first touches of a block miss
+    model = createModel("fa:2:4", main_mem);
+    runPattern(model);
+    stats = model->stats;
+    expect("fa", "hits", stats->hits, 2);
+    expect("fa", "misses", stats->misses, 3);
+    expect("fa", "fills", stats->fills, 3);
+    expect("fa", "evictions", stats->evictions, 0);
+    expect("fa", "sets", stats->num_sets, 1);
+
+    // Snapshots are independent of the cache
+    CacheStats copy;
+    if (copyCacheStats(&copy, stats) != 0) {
+        printf("copyCacheStats failed\n");
+        exit(-1);
+    }
+    resetCacheStats(stats);
+    expect("fa copy", "hits", copy.hits, 2);
+    expect("fa copy", "set 0 misses", copy.set_misses[0], 3);
+    freeCacheModel(model);
+
+    // Both exports carry the totals and the per set counters
+    FILE *file = tmpfile();
+    char text[1024];
+    writeCacheStatsJSON(file, &copy, "fa:2:4", 1);
+    rewind(file);
+    size_t len = fread(text, 1, sizeof(text) - 1, file);
+    text[len] = '\0';
+    if (strstr(text, "{\"config\": \"fa:2:4\", \"level\": 1, \"accesses\": 5,") != text ||
+        strstr(text, "\"hit_rate\": 0.400000") == NULL || strstr(text, "\"set_misses\": [3]") == NULL ||
+        text[len - 1] != '}') {
+        printf("writeCacheStatsJSON produced %s\n", text);
+        exit(-1);
+    }
+    fclose(file);
+
+    file = tmpfile();
+    writeCacheStatsCSVHeader(file);
+    writeCacheStatsCSV(file, &copy, "fa:2:4", 1);
+    rewind(file);
+    len = fread(text, 1, sizeof(text) - 1, file);
+    text[len] = '\0';
+    if (strcmp(text, "config,level,set,accesses,reads,writes,hits,misses,fills,evictions,write_backs,invalidations,"
+                     "compulsory_misses,capacity_misses,conflict_misses\n"
+                     "\"fa:2:4\",1,all,5,4,1,2,3,3,0,0,0,0,0,0\n"
+                     "\"fa:2:4\",1,0,5,,,2,3,,0,,,,,\n") != 0) {
+        printf("writeCacheStatsCSV produced %s\n", text);
+        exit(-1);
+    }
+    fclose(file);
+    freeCacheStats(&copy);
+
+    freeMainMem(main_mem);
+    printf("Cache Stats Test 01 Finished\n");
+}
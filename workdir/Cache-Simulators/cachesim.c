@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "main_mem.h"
+#include "cache_model.h"
+#include "log_writer.h"
+#include "replay.h"
+#include "stack_dist.h"
+#include "trace.h"
+
+// cachesim
+//
+// Replays a binary trace (see trace.h) through one cache model and
+// reports replay throughput. Given several configurations (or @file
+// listing one per line) it sweeps them on a thread pool over a single
+// mapping of the trace and prints one results table. In stack distance
+// mode the trace is instead run once through a StackDist engine and
+// hit/miss counts are reported for every associativity and fully
+// associative size it covers.
+//
+// Usage: cachesim [-j threads] [-l full|counts|off] [-L log_file] [-m image] [-s] [-S stats_file] <trace_file> <address_width> <cache_config>...
+//        -l selects the MainMem log mode (default counts, see main_mem_log.h)
+//        -L streams a full MainMem log to log_file while the trace replays,
+//           leaving out the counts of words never accessed (see
+//           log_writer.h), as a binary log if its name ends in .bin (see
+//           log_binary.h); single configuration only
+//        -m starts every MainMem from a binary image (see writeMainMemImage)
+//        -s uses a sparse MainMem (see createSparseMainMem)
+//        -S writes every level's counters (see cache_stats.h) to stats_file,
+//           as JSON if its name ends in .json and CSV otherwise
+//        cache_config is one of dm:<s>:<w>, fa:<w>:<lines>[:<policy>][+wb:<entries>],
+//        sa:<s>:<w>:<ways>[:<policy>][+<prefetcher>] (see replacement.h for
+//        policies, prefetch.h for prefetchers and write_buffer.h), each
+//        level taking +<write> write policy suffixes (see cache_model.h)
+//        and DM and SA levels a +3c miss classification suffix (see miss_class.h),
+//        a hierarchy of those levels joined by '/' from L1 down with an
+//        optional ,nine|incl|excl inclusion suffix (see backing_store.h),
+//        or stackdist:<s>:<w>:<max_ways>:<max_lines>
+
+static double elapsedSeconds(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-j threads] [-l full|counts|off] [-L log_file] [-m image] [-s] [-S stats_file] <trace_file> <address_width> <cache_config>...\n", prog);
+    fprintf(stderr, "  cache_config: dm:<set_bits>:<word_bits>[+<write>...][+3c]\n");
+    fprintf(stderr, "                fa:<word_bits>:<num_lines>[:<policy>][+<write>...][+wb:<write_buffer_entries>]\n");
+    fprintf(stderr, "                sa:<set_bits>:<word_bits>:<lines_per_set>[:<policy>][+<write>...][+3c][+<prefetcher>]\n");
+    fprintf(stderr, "                   [+sector:<words>]\n");
+    fprintf(stderr, "                <level>/<level>...[,nine|incl|excl] for a hierarchy, L1 first\n");
+    fprintf(stderr, "                @<file listing one cache_config per line>\n");
+    fprintf(stderr, "  policy: lru (default), plru, fifo, random, srrip, brrip, dip\n");
+    fprintf(stderr, "  write: back|through, alloc|noalloc|around\n");
+    fprintf(stderr, "  3c: classify misses as compulsory, capacity or conflict\n");
+    fprintf(stderr, "  prefetcher: next|stride|stream[:<degree>[:<distance>]]\n");
+    fprintf(stderr, "  or a single stackdist:<set_bits>:<word_bits>:<max_ways>:<max_lines>\n");
+}
+
+static void printHitRow(CacheConfig *config, uint64_t accesses, uint64_t hits) {
+    char config_str[CACHE_CONFIG_STR_LEN];
+    formatCacheConfig(config, config_str);
+    printf("%-20s %14llu %14llu %14llu %9.5f\n", config_str,
+           (unsigned long long) accesses, (unsigned long long) hits,
+           (unsigned long long) (accesses - hits),
+           accesses > 0 ? (double) (accesses - hits) / accesses : 0.0);
+}
+
+static int replayStackDist(Trace *trace, uint32_t address_width, char *spec) {
+    uint32_t set_bits, word_bits, max_ways, max_lines;
+    char tail;
+    if (sscanf(spec, "stackdist:%u:%u:%u:%u%c", &set_bits, &word_bits,
+               &max_ways, &max_lines, &tail) != 4) {
+        return 1;
+    }
+
+    StackDist *sd = createStackDist(set_bits, word_bits, max_ways, max_lines);
+    if (sd == NULL) {
+        fprintf(stderr, "cannot create stack distance engine %s\n", spec);
+        return 1;
+    }
+
+    uint64_t limit = (address_width >= 32) ? 0x100000000ULL : (1ULL << address_width);
+    uint64_t errors = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t i = 0; i < trace->record_count; i++) {
+        uint32_t address = trace->records[i].address;
+        if (address >= limit) {
+            errors++;
+        } else {
+            stackDistAccess(sd, address);
+        }
+        if ((i % REPLAY_CHUNK) == 0) {
+            releaseTraceRecords(trace, i);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = elapsedSeconds(&start, &end);
+
+    printf("stack distance, address width %u\n", address_width);
+    printf("replayed %llu records in %.3f s (%.0f records/s), errors %llu\n",
+           (unsigned long long) trace->record_count, seconds,
+           seconds > 0 ? trace->record_count / seconds : 0.0,
+           (unsigned long long) errors);
+    printf("%-20s %14s %14s %14s %9s\n", "config", "accesses", "hits", "misses", "miss_rate");
+
+    CacheConfig config;
+    config.word_index_bitcount = word_bits;
+    config.policy = REPL_LRU;
+    config.prefetch.type = PREFETCH_NONE;
+    config.write_buffer_entries = 0;
+    config.classify_misses = 0;
+    config.sector_words = 0;
+    config.num_lower = 0;
+    config.inclusion = INCLUSION_NON_INCLUSIVE;
+    for (uint32_t ways = 1; ways <= max_ways; ways++) {
+        config.type = ways == 1 ? DM_CACHE_MODEL : SA_CACHE_MODEL;
+        config.set_index_bitcount = set_bits;
+        config.lines_per_set = ways;
+        config.write_policy = defaultWritePolicy(config.type);
+        printHitRow(&config, sd->accesses, stackDistSetHits(sd, ways));
+    }
+    // Fully associative sizes are reported at powers of two and max_lines
+    config.type = FA_CACHE_MODEL;
+    config.set_index_bitcount = 0;
+    config.write_policy = defaultWritePolicy(config.type);
+    uint32_t lines = 1;
+    for (;;) {
+        config.lines_per_set = lines;
+        printHitRow(&config, sd->accesses, stackDistFAHits(sd, lines));
+        if (lines == max_lines) {
+            break;
+        }
+        lines = (lines * 2 < max_lines) ? lines * 2 : max_lines;
+    }
+
+    freeStackDist(sd);
+    return errors == 0 ? 0 : 2;
+}
+
+// Appends configuration spec (or every line of @file) to configs.
+// Returns 0 on success, -1 on a malformed configuration.
+static int addConfigs(char *arg, CacheConfig **configs, uint32_t *count, uint32_t *capacity) {
+    FILE *file = NULL;
+    char line[128];
+    char *spec = arg;
+
+    if (arg[0] == '@') {
+        file = fopen(arg + 1, "r");
+        if (file == NULL) {
+            fprintf(stderr, "cannot open configuration list %s\n", arg + 1);
+            return -1;
+        }
+    }
+
+    for (;;) {
+        if (file != NULL) {
+            if (fgets(line, sizeof(line), file) == NULL) {
+                break;
+            }
+            line[strcspn(line, " \t\r\n#")] = '\0';
+            if (line[0] == '\0') {
+                continue;
+            }
+            spec = line;
+        }
+
+        if (*count == *capacity) {
+            *capacity = *capacity == 0 ? 16 : *capacity * 2;
+            CacheConfig *grown = (CacheConfig *) realloc(*configs, *capacity * sizeof(CacheConfig));
+            if (grown == NULL) {
+                if (file != NULL) {
+                    fclose(file);
+                }
+                return -1;
+            }
+            *configs = grown;
+        }
+        if (parseCacheConfig(spec, &(*configs)[*count]) != 0) {
+            fprintf(stderr, "malformed cache configuration %s\n", spec);
+            if (file != NULL) {
+                fclose(file);
+            }
+            return -1;
+        }
+        (*count)++;
+
+        if (file == NULL) {
+            break;
+        }
+    }
+
+    if (file != NULL) {
+        fclose(file);
+    }
+    return 0;
+}
+
+static void printReplayRow(CacheConfig *config, uint64_t record_count, ReplayResult *result) {
+    char config_str[CACHE_CONFIG_STR_LEN];
+    formatCacheConfig(config, config_str);
+    if (result->status != 0) {
+        printf("%-20s %s\n", config_str, "cannot create cache");
+        return;
+    }
+    printf("%-20s %12llu %12llu %10llu %10llu %12llu %12llu %10.3f %14.0f\n", config_str,
+           (unsigned long long) result->reads, (unsigned long long) result->writes,
+           (unsigned long long) result->skipped, (unsigned long long) result->errors,
+           (unsigned long long) result->mem_reads, (unsigned long long) result->mem_writes,
+           result->seconds, result->seconds > 0 ? record_count / result->seconds : 0.0);
+}
+
+static int hasPrefetcher(CacheConfig *config) {
+    int found = config->prefetch.type != PREFETCH_NONE;
+    for (uint32_t i = 0; i < config->num_lower; i++) {
+        found = found || config->lower[i].prefetch.type != PREFETCH_NONE;
+    }
+    return found;
+}
+
+static void printPrefetchRow(CacheConfig *config, ReplayResult *result) {
+    char config_str[CACHE_CONFIG_STR_LEN];
+    PrefetchStats *stats = &result->prefetch;
+    formatCacheConfig(config, config_str);
+    printf("%-20s %12llu %12llu %12llu %12llu %12llu %9.5f\n", config_str,
+           (unsigned long long) stats->issued, (unsigned long long) stats->useful,
+           (unsigned long long) stats->late, (unsigned long long) stats->unused,
+           (unsigned long long) stats->polluting,
+           stats->issued > 0 ? (double) stats->useful / stats->issued : 0.0);
+}
+
+// Returns non-zero if level (0 for L1) of config classifies its misses
+static int classifiesMisses(CacheConfig *config, uint32_t level) {
+    return level == 0 ? config->classify_misses : config->lower[level - 1].classify_misses;
+}
+
+// Shares are fractions of the level's misses
+static void printMissClassRow(CacheConfig *config, uint32_t level, CacheStats *stats) {
+    char config_str[CACHE_CONFIG_STR_LEN];
+    formatCacheConfig(config, config_str);
+    double misses = stats->misses > 0 ? (double) stats->misses : 1.0;
+    printf("%-20s %5u %12llu %12llu %12llu %12llu %10.5f %10.5f %10.5f\n", config_str, level + 1,
+           (unsigned long long) stats->misses, (unsigned long long) stats->compulsory_misses,
+           (unsigned long long) stats->capacity_misses, (unsigned long long) stats->conflict_misses,
+           stats->compulsory_misses / misses, stats->capacity_misses / misses,
+           stats->conflict_misses / misses);
+}
+
+static int hasWriteBuffer(CacheConfig *config) {
+    int found = config->write_buffer_entries != 0;
+    for (uint32_t i = 0; i < config->num_lower; i++) {
+        found = found || config->lower[i].write_buffer_entries != 0;
+    }
+    return found;
+}
+
+// Words saved is the write through traffic the buffer coalesced away
+static void printWriteBufferRow(CacheConfig *config, ReplayResult *result) {
+    char config_str[CACHE_CONFIG_STR_LEN];
+    WriteBufferStats *stats = &result->write_buffer;
+    formatCacheConfig(config, config_str);
+    printf("%-20s %12llu %12llu %12llu %12llu %10llu %10llu %10llu\n", config_str,
+           (unsigned long long) stats->words_in, (unsigned long long) stats->words_out,
+           (unsigned long long) (stats->words_in - stats->words_out),
+           (unsigned long long) stats->writes_out, (unsigned long long) stats->capacity_drains,
+           (unsigned long long) stats->conflict_drains, (unsigned long long) stats->explicit_drains);
+}
+
+// Writes the counters of every level of every configuration that ran to
+// file_name, as JSON if it ends in .json and CSV otherwise. Returns 0 on
+// success, -1 if the file cannot be written.
+static int writeStatsFile(char *file_name, CacheConfig *configs, ReplayResult *results, uint32_t num_configs) {
+    FILE *file = fopen(file_name, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t len = strlen(file_name);
+    int json = len >= 5 && strcmp(file_name + len - 5, ".json") == 0;
+    char config_str[CACHE_CONFIG_STR_LEN];
+    int first = 1;
+
+    if (json) {
+        fprintf(file, "[");
+    } else {
+        writeCacheStatsCSVHeader(file);
+    }
+    for (uint32_t i = 0; i < num_configs; i++) {
+        formatCacheConfig(&configs[i], config_str);
+        for (uint32_t level = 0; level < results[i].num_levels; level++) {
+            if (json) {
+                fprintf(file, first ? "\n  " : ",\n  ");
+                writeCacheStatsJSON(file, &results[i].level_stats[level], config_str, level + 1);
+            } else {
+                writeCacheStatsCSV(file, &results[i].level_stats[level], config_str, level + 1);
+            }
+            first = 0;
+        }
+    }
+    if (json) {
+        fprintf(file, "\n]\n");
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    ReplayOptions options = {0, LOG_COUNTS_ONLY, NULL, 0, 0};
+    char *stats_file = NULL;
+    char *log_file = NULL;
+    int argi = 1;
+
+    while (argi + 1 < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-s") == 0) {
+            options.sparse = 1;
+            argi++;
+            continue;
+        }
+        if (strcmp(argv[argi], "-j") == 0) {
+            options.num_threads = (uint32_t) strtoul(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "-m") == 0) {
+            options.image_file = argv[argi + 1];
+        } else if (strcmp(argv[argi], "-S") == 0) {
+            stats_file = argv[argi + 1];
+        } else if (strcmp(argv[argi], "-L") == 0) {
+            log_file = argv[argi + 1];
+        } else if (strcmp(argv[argi], "-l") == 0 && strcmp(argv[argi + 1], "full") == 0) {
+            options.log_mode = LOG_FULL;
+        } else if (strcmp(argv[argi], "-l") == 0 && strcmp(argv[argi + 1], "counts") == 0) {
+            options.log_mode = LOG_COUNTS_ONLY;
+        } else if (strcmp(argv[argi], "-l") == 0 && strcmp(argv[argi + 1], "off") == 0) {
+            options.log_mode = LOG_OFF;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        argi += 2;
+    }
+
+    if (argc - argi < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char *trace_file = argv[argi];
+    uint32_t address_width = (uint32_t) strtoul(argv[argi + 1], NULL, 10);
+    options.address_width = address_width;
+    argi += 2;
+
+    if (strncmp(argv[argi], "stackdist:", 10) == 0) {
+        if (argc - argi != 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        Trace *trace = openTrace(trace_file);
+        if (trace == NULL) {
+            fprintf(stderr, "cannot open trace %s\n", trace_file);
+            return 1;
+        }
+        int result = replayStackDist(trace, address_width, argv[argi]);
+        if (result == 1) {
+            usage(argv[0]);
+        }
+        closeTrace(trace);
+        return result;
+    }
+
+    CacheConfig *configs = NULL;
+    uint32_t num_configs = 0;
+    uint32_t capacity = 0;
+    for (; argi < argc; argi++) {
+        if (addConfigs(argv[argi], &configs, &num_configs, &capacity) != 0) {
+            usage(argv[0]);
+            free(configs);
+            return 1;
+        }
+    }
+    if (num_configs == 0 || (log_file != NULL && num_configs != 1)) {
+        usage(argv[0]);
+        free(configs);
+        return 1;
+    }
+
+    Trace *trace = openTrace(trace_file);
+    if (trace == NULL) {
+        fprintf(stderr, "cannot open trace %s\n", trace_file);
+        free(configs);
+        return 1;
+    }
+
+    ReplayResult *results = (ReplayResult *) calloc(num_configs, sizeof(ReplayResult));
+    if (results == NULL) {
+        closeTrace(trace);
+        free(configs);
+        return 1;
+    }
+
+    if (options.num_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        options.num_threads = online > 0 ? (uint32_t) online : 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (num_configs == 1) {
+        // Single configuration streams the trace and releases consumed pages
+        if (log_file != NULL) {
+            options.log_mode = LOG_FULL;
+        }
+        MainMem *mem = createReplayMainMem(&options);
+        CacheModel *model = mem == NULL ? NULL : createCacheModel(mem, &configs[0]);
+        LogWriter *writer = NULL;
+        if (model != NULL && log_file != NULL) {
+            size_t len = strlen(log_file);
+            int binary = len >= 4 && strcmp(log_file + len - 4, ".bin") == 0;
+            writer = openLogWriter(log_file, binary ? LOG_FILE_BINARY : LOG_FILE_TEXT, 1);
+        }
+        if (model == NULL || (log_file != NULL && writer == NULL)) {
+            results[0].status = -1;
+        } else {
+            if (writer != NULL) {
+                attachLogWriter(writer, mem->op_log);
+            }
+            replayTrace(model, trace, 1, &results[0]);
+            if (writer != NULL && closeLogWriter(writer, mem->op_log) != 0) {
+                fprintf(stderr, "cannot write log %s\n", log_file);
+                results[0].status = -1;
+            }
+        }
+        if (model != NULL) {
+            freeCacheModel(model);
+        }
+        freeMainMem(mem);
+    } else {
+        runSweep(trace, configs, num_configs, &options, results);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = elapsedSeconds(&start, &end);
+
+    printf("trace %s, %llu records, address width %u\n", trace_file,
+           (unsigned long long) trace->record_count, address_width);
+    if (num_configs > 1) {
+        printf("swept %u configurations on %u threads in %.3f s (%.0f records/s aggregate)\n",
+               num_configs, options.num_threads < num_configs ? options.num_threads : num_configs, seconds,
+               seconds > 0 ? (double) trace->record_count * num_configs / seconds : 0.0);
+    }
+    printf("%-20s %12s %12s %10s %10s %12s %12s %10s %14s\n", "config", "reads", "writes",
+           "skipped", "errors", "mem_reads", "mem_writes", "seconds", "records/s");
+
+    int status = 0;
+    for (uint32_t i = 0; i < num_configs; i++) {
+        printReplayRow(&configs[i], trace->record_count, &results[i]);
+        if (results[i].status != 0 || results[i].errors != 0) {
+            status = 2;
+        }
+    }
+
+    int header = 0;
+    for (uint32_t i = 0; i < num_configs; i++) {
+        if (results[i].status != 0 || !hasPrefetcher(&configs[i])) {
+            continue;
+        }
+        if (!header) {
+            printf("%-20s %12s %12s %12s %12s %12s %9s\n", "prefetch", "issued", "useful",
+                   "late", "unused", "polluting", "accuracy");
+            header = 1;
+        }
+        printPrefetchRow(&configs[i], &results[i]);
+    }
+
+    header = 0;
+    for (uint32_t i = 0; i < num_configs; i++) {
+        if (results[i].status != 0 || !hasWriteBuffer(&configs[i])) {
+            continue;
+        }
+        if (!header) {
+            printf("%-20s %12s %12s %12s %12s %10s %10s %10s\n", "write buffer", "words_in",
+                   "words_out", "words_saved", "writes_out", "capacity", "conflict", "explicit");
+            header = 1;
+        }
+        printWriteBufferRow(&configs[i], &results[i]);
+    }
+
+    header = 0;
+    for (uint32_t i = 0; i < num_configs; i++) {
+        for (uint32_t level = 0; results[i].status == 0 && level < results[i].num_levels; level++) {
+            if (!classifiesMisses(&configs[i], level)) {
+                continue;
+            }
+            if (!header) {
+                printf("%-20s %5s %12s %12s %12s %12s %10s %10s %10s\n", "3c", "level", "misses",
+                       "compulsory", "capacity", "conflict", "comp_pct", "cap_pct", "conf_pct");
+                header = 1;
+            }
+            printMissClassRow(&configs[i], level, &results[i].level_stats[level]);
+        }
+    }
+
+    if (stats_file != NULL && writeStatsFile(stats_file, configs, results, num_configs) != 0) {
+        fprintf(stderr, "cannot write statistics to %s\n", stats_file);
+        status = 1;
+    }
+
+    for (uint32_t i = 0; i < num_configs; i++) {
+        freeReplayResult(&results[i]);
+    }
+    free(results);
+    free(configs);
+    closeTrace(trace);
+    return status;
+}
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+#include "coherence.h"
+
+// Port callbacks, defined below
+static int portFill(void *impl, uint32_t block_addr, uint32_t *block, int exclusive, uint8_t *shared);
+static void portUpgrade(void *impl, uint32_t block_addr);
+static int portReadStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty);
+static int portWriteStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind);
+static void portInvalidateStore(void *impl, uint32_t address, uint32_t count);
+
+//----------------------
+// createCoherentSystem
+//
+// Arguments: mem - MainMem shared by every core
+//            num_cores - number of private caches, 1 to COHERENCE_MAX_CORES
+//            set_index_bitcount, word_index_bitcount, lines_per_set,
+//            policy - geometry and replacement policy of each cache
+//
+// Results: Pointer to the new system, or NULL on error. Every cache is
+//          write back, write allocate and fills through its port.
+//
+CoherentSystem *createCoherentSystem(MainMem *mem, uint32_t num_cores,
+                                     uint32_t set_index_bitcount,
+                                     uint32_t word_index_bitcount,
+                                     uint32_t lines_per_set,
+                                     ReplacementType policy) {
+    if (mem == NULL || num_cores == 0 || num_cores > COHERENCE_MAX_CORES ||
+        mem->address_width <= set_index_bitcount + word_index_bitcount + 2) {
+        return NULL;
+    }
+    CoherentSystem *system = (CoherentSystem *) calloc(1, sizeof(CoherentSystem));
+    if (system == NULL) {
+        return NULL;
+    }
+
+    uint32_t block_bits = mem->address_width - word_index_bitcount - 2;
+    system->num_cores = num_cores;
+    system->word_index_bitcount = word_index_bitcount;
+    system->mem = mem;
+    system->cores = (SACache **) calloc(num_cores, sizeof(SACache *));
+    system->ports = (CoherencePort *) calloc(num_cores, sizeof(CoherencePort));
+    system->lost = (PageTable **) calloc(num_cores, sizeof(PageTable *));
+    system->stats = (CoherenceStats *) calloc(num_cores, sizeof(CoherenceStats));
+    system->snoop_block = (uint32_t *) malloc(sizeof(uint32_t) << word_index_bitcount);
+    system->directory = createPageTable((uint32_t) (1ULL << block_bits));
+    system->last_write = createPageTable((uint32_t) (1ULL << (mem->address_width - 2)));
+    if (system->cores == NULL || system->ports == NULL || system->lost == NULL || system->stats == NULL ||
+        system->snoop_block == NULL || system->directory == NULL || system->last_write == NULL) {
+        freeCoherentSystem(system);
+        return NULL;
+    }
+
+    WritePolicy write_policy = {WRITE_HIT_BACK, WRITE_MISS_ALLOCATE};
+    for (uint32_t i = 0; i < num_cores; i++) {
+        system->cores[i] = createSACacheWithPolicy(mem, set_index_bitcount, word_index_bitcount,
+                                                   lines_per_set, policy);
+        system->lost[i] = createPageTable((uint32_t) (1ULL << block_bits));
+        if (system->cores[i] == NULL || system->lost[i] == NULL) {
+            freeCoherentSystem(system);
+            return NULL;
+        }
+
+        CoherencePort *port = &system->ports[i];
+        port->system = system;
+        port->core = i;
+        port->store.impl = port;
+        port->store.address_width = mem->address_width;
+        port->store.block_words = 1 << word_index_bitcount;
+        port->store.write_back = 0;
+        port->store.inclusion = INCLUSION_NON_INCLUSIVE;
+        port->store.next = &mem->store;
+        port->store.above = &system->cores[i]->store;
+        port->store.read_block = portReadStore;
+        port->store.write_block = portWriteStore;
+        port->store.invalidate_block = portInvalidateStore;
+
+        SACoherence hooks = {port, portFill, portUpgrade};
+        setSAWritePolicy(system->cores[i], write_policy);
+        if (attachSACoherence(system->cores[i], &hooks) != 0) {
+            freeCoherentSystem(system);
+            return NULL;
+        }
+        system->cores[i]->store.next = &port->store;
+    }
+    return system;
+}
+
+void freeCoherentSystem(CoherentSystem *system) {
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        if (system->cores != NULL && system->cores[i] != NULL) {
+            freeSACache(system->cores[i]);
+        }
+        if (system->lost != NULL) {
+            freePageTable(system->lost[i]);
+        }
+    }
+    freePageTable(system->directory);
+    freePageTable(system->last_write);
+    free(system->cores);
+    free(system->ports);
+    free(system->lost);
+    free(system->stats);
+    free(system->snoop_block);
+    free(system);
+}
+
+// Counts a miss of core on block_num as true or false sharing if the core
+// lost the block to an invalidation, and forgets the invalidation
+static void countCoherenceMiss(CoherentSystem *system, uint32_t core, uint32_t block_num) {
+    uint32_t *page = findPage(system->lost[core], block_num);
+    if (page == NULL || page[block_num & (PT_PAGE_WORDS - 1)] == 0) {
+        return;
+    }
+    uint32_t invalidated = page[block_num & (PT_PAGE_WORDS - 1)];
+    page[block_num & (PT_PAGE_WORDS - 1)] = 0;
+    if (peekWord(system->last_write, system->current_address >> 2) >= invalidated) {
+        system->stats[core].true_sharing_misses++;
+    } else {
+        system->stats[core].false_sharing_misses++;
+    }
+}
+
+// Probes every core other than core listed in holders for block_addr,
+// invalidating their copies if invalidate is non-zero and sharing them
+// otherwise. Modified copies are written to MainMem. Returns the cores
+// that still hold a copy.
+static uint32_t snoopOthers(CoherentSystem *system, uint32_t core, uint32_t holders, uint32_t block_addr,
+                            int invalidate) {
+    CoherenceStats *stats = &system->stats[core];
+    BackingStore *mem_store = &system->mem->store;
+    uint32_t block_num = block_addr >> (system->word_index_bitcount + 2);
+    uint32_t remaining = 0;
+
+    holders &= ~(COHERENCE_OWNED | (1u << core));
+    for (uint32_t other = 0; holders != 0; other++, holders >>= 1) {
+        if ((holders & 1) == 0) {
+            continue;
+        }
+        SASnoopResult result = snoopSACache(system->cores[other], block_addr, invalidate, system->snoop_block);
+        if (result == SA_SNOOP_MISS) {
+            continue;
+        }
+        if (result == SA_SNOOP_DIRTY) {
+            mem_store->write_block(mem_store->impl, block_addr, system->snoop_block,
+                                   1 << system->word_index_bitcount, STORE_WRITE_BACK);
+            stats->interventions++;
+        }
+        if (invalidate) {
+            uint32_t *lost = touchWord(system->lost[other], block_num);
+            if (lost != NULL) {
+                *lost = system->write_seq + 1;
+            }
+            stats->invalidations++;
+        } else {
+            remaining |= 1u << other;
+        }
+    }
+    return remaining;
+}
+
+//----------------------
+// Coherence hooks of each core's cache (see sa_cache.h)
+
+static int portFill(void *impl, uint32_t block_addr, uint32_t *block, int exclusive, uint8_t *shared) {
+    CoherencePort *port = (CoherencePort *) impl;
+    CoherentSystem *system = port->system;
+    uint32_t block_num = block_addr >> (system->word_index_bitcount + 2);
+    uint32_t *entry = touchWord(system->directory, block_num);
+    if (entry == NULL) {
+        return -1;
+    }
+
+    if (exclusive) {
+        system->stats[port->core].bus_read_xs++;
+    } else {
+        system->stats[port->core].bus_reads++;
+    }
+    countCoherenceMiss(system, port->core, block_num);
+    uint32_t holders = snoopOthers(system, port->core, *entry, block_addr, exclusive);
+
+    BackingStore *mem_store = &system->mem->store;
+    uint8_t dirty;
+    if (mem_store->read_block(mem_store->impl, block_addr, block, 1 << system->word_index_bitcount, &dirty) != 0) {
+        return -1;
+    }
+    *shared = holders != 0;
+    *entry = holders != 0 ? (holders | (1u << port->core)) : (COHERENCE_OWNED | (1u << port->core));
+    return 0;
+}
+
+static void portUpgrade(void *impl, uint32_t block_addr) {
+    CoherencePort *port = (CoherencePort *) impl;
+    CoherentSystem *system = port->system;
+    uint32_t block_num = block_addr >> (system->word_index_bitcount + 2);
+    uint32_t *entry = touchWord(system->directory, block_num);
+
+    system->stats[port->core].upgrades++;
+    if (entry != NULL) {
+        snoopOthers(system, port->core, *entry, block_addr, 1);
+        *entry = COHERENCE_OWNED | (1u << port->core);
+    }
+}
+
+//----------------------
+// Backing store callbacks of each port, the store.next of its cache
+
+// Only reached by fills that bypass the hooks; served as a bus read
+static int portReadStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty) {
+    CoherencePort *port = (CoherencePort *) impl;
+    uint32_t block_words = 1 << port->system->word_index_bitcount;
+    uint32_t block_addr = address & ~(block_words * sizeof(uint32_t) - 1);
+    uint8_t shared;
+    *dirty = 0;
+    if (count != block_words || address != block_addr) {
+        BackingStore *mem_store = &port->system->mem->store;
+        return mem_store->read_block(mem_store->impl, address, values, count, dirty);
+    }
+    return portFill(impl, block_addr, values, 0, &shared);
+}
+
+// Write back of a Modified line; the core gives up the block. A line
+// with several runs of dirty words writes each, counted once.
+static int portWriteStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind) {
+    CoherencePort *port = (CoherencePort *) impl;
+    CoherentSystem *system = port->system;
+    BackingStore *mem_store = &system->mem->store;
+    uint32_t block_num = address >> (system->word_index_bitcount + 2);
+
+    if (kind == STORE_WRITE_BACK) {
+        uint32_t *page = findPage(system->directory, block_num);
+        uint32_t *entry = page != NULL ? &page[block_num & (PT_PAGE_WORDS - 1)] : NULL;
+        if (entry == NULL || (*entry & (1u << port->core)) != 0) {
+            system->stats[port->core].write_backs++;
+        }
+        if (entry != NULL) {
+            *entry &= ~(1u << port->core);
+            if ((*entry & ~COHERENCE_OWNED) == 0) {
+                *entry = 0;
+            }
+        }
+    }
+    return mem_store->write_block(mem_store->impl, address, values, count, kind);
+}
+
+// Nothing sits below a port's cache but MainMem
+static void portInvalidateStore(void *impl, uint32_t address, uint32_t count) {
+    (void) impl;
+    (void) address;
+    (void) count;
+}
+
+int coherentReadByte(CoherentSystem *system, uint32_t core, uint32_t address, uint8_t *value) {
+    if (core >= system->num_cores) {
+        return SA_INVALID_CACHE;
+    }
+    system->current_address = address;
+    system->stats[core].reads++;
+    return readByte(system->cores[core], address, value);
+}
+
+int coherentWriteByte(CoherentSystem *system, uint32_t core, uint32_t address, uint8_t value) {
+    if (core >= system->num_cores) {
+        return SA_INVALID_CACHE;
+    }
+    system->current_address = address;
+    system->stats[core].writes++;
+    SACacheResult result = writeByte(system->cores[core], address, value);
+    if (result == SA_CACHE_SUCCESS) {
+        uint32_t *word = touchWord(system->last_write, address >> 2);
+        system->write_seq++;
+        if (word != NULL) {
+            *word = system->write_seq;
+        }
+    }
+    return result;
+}
+
+void flushCoherentSystem(CoherentSystem *system) {
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        flushCache(system->cores[i]);
+    }
+    clearPageTable(system->directory);
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        clearPageTable(system->lost[i]);
+    }
+}
+
+void sumCoherenceStats(CoherentSystem *system, CoherenceStats *total) {
+    memset(total, 0, sizeof(CoherenceStats));
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        CoherenceStats *stats = &system->stats[i];
+        total->reads += stats->reads;
+        total->writes += stats->writes;
+        total->bus_reads += stats->bus_reads;
+        total->bus_read_xs += stats->bus_read_xs;
+        total->upgrades += stats->upgrades;
+        total->write_backs += stats->write_backs;
+        total->invalidations += stats->invalidations;
+        total->interventions += stats->interventions;
+        total->true_sharing_misses += stats->true_sharing_misses;
+        total->false_sharing_misses += stats->false_sharing_misses;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+#include <stdint.h>
+#include "main_mem.h"
+#include "page_table.h"
+#include "sa_cache.h"
+
+// CoherentSystem
+//
+// num_cores private write back SACaches sharing one MainMem under a MESI
+// protocol. A directory holds, per block, the set of cores that may have
+// a copy and whether one of them owns it (Exclusive or Modified). Each
+// cache fills through its core's port (attachSACoherence):
+//
+//   bus read      read miss. A Modified owner supplies the block
+//                 (intervention), writing it to MainMem, and every holder
+//                 keeps a Shared copy. The requester gets Exclusive if no
+//                 other core holds the block.
+//   bus read x    write miss. Every other copy is invalidated, a Modified
+//                 one supplying the block first.
+//   upgrade       write hit to a Shared line. Every other copy is
+//                 invalidated.
+//   write back    eviction of a Modified line, written to MainMem.
+//
+// Clean lines are evicted silently, so the directory may list cores that
+// no longer hold a block; the protocol probes each listed core with
+// snoopSACache and only counts copies actually found.
+//
+// A miss on a block the core lost to an invalidation is a coherence miss.
+// It is true sharing if the word accessed was written by another core
+// since the invalidation and false sharing otherwise, i.e. the block
+// moved only because a different word of it was written. Words are
+// tracked by a 32-bit write sequence number, so the distinction is exact
+// for the first 2^32 - 1 writes.
+//
+// Accesses are not synchronized; callers running cores on several
+// threads must serialize them (see replayCoherentTraces in replay.h).
+
+// Largest number of cores of a CoherentSystem
+#define COHERENCE_MAX_CORES 31
+
+// Directory flag marking a block owned by the single core listed
+#define COHERENCE_OWNED 0x80000000
+
+typedef struct CoherenceStats {
+    uint64_t reads;                 // readByte accesses of the core
+    uint64_t writes;                // writeByte accesses of the core
+    uint64_t bus_reads;             // Read misses
+    uint64_t bus_read_xs;           // Write misses
+    uint64_t upgrades;              // Writes to Shared lines
+    uint64_t write_backs;           // Modified lines written to MainMem on eviction
+    uint64_t invalidations;         // Copies in other caches invalidated by the core
+    uint64_t interventions;         // Misses of the core served from another core's Modified copy
+    uint64_t true_sharing_misses;   // Coherence misses on a word written by another core
+    uint64_t false_sharing_misses;  // Coherence misses on a word no other core wrote
+} CoherenceStats;
+
+struct CoherentSystem;
+
+// Port of one core: the impl of its cache's hooks and store.next
+typedef struct CoherencePort {
+    struct CoherentSystem *system;
+    uint32_t core;
+    BackingStore store;
+} CoherencePort;
+
+typedef struct CoherentSystem {
+    uint32_t num_cores;
+    uint32_t word_index_bitcount;
+    MainMem *mem;
+    SACache **cores;
+    CoherencePort *ports;
+    PageTable *directory;   // Per block: bit per core that may hold it, plus COHERENCE_OWNED
+    PageTable *last_write;  // Per word: write_seq of its last write, 0 if never written
+    PageTable **lost;       // Per core, per block: write_seq + 1 when its copy was invalidated
+    uint32_t write_seq;     // Writes performed so far
+    uint32_t current_address;   // Address of the access being performed
+    uint32_t *snoop_block;  // Block supplied by a Modified copy
+    CoherenceStats *stats;  // num_cores per core counters
+} CoherentSystem;
+
+// createCoherentSystem
+// Creates num_cores SACaches of the given geometry and replacement
+// policy over mem, which must not be used through any other cache.
+// Returns NULL on error, including more than COHERENCE_MAX_CORES cores.
+
+CoherentSystem *createCoherentSystem(MainMem *mem, uint32_t num_cores,
+                                     uint32_t set_index_bitcount,
+                                     uint32_t word_index_bitcount,
+                                     uint32_t lines_per_set,
+                                     ReplacementType policy);
+
+// Frees system and its caches, discarding Modified lines; write them out
+// first with flushCoherentSystem
+void freeCoherentSystem(CoherentSystem *system);
+
+// Reads byte at address through core's cache. Returns an SACacheResult.
+int coherentReadByte(CoherentSystem *system, uint32_t core, uint32_t address, uint8_t *value);
+
+// Writes byte at address through core's cache. Returns an SACacheResult.
+int coherentWriteByte(CoherentSystem *system, uint32_t core, uint32_t address, uint8_t value);
+
+// Writes back every Modified line, counting each in write_backs, and
+// invalidates every cache. The directory and the invalidations
+// remembered for coherence misses are cleared, so the next miss on any
+// block is a cold miss.
+void flushCoherentSystem(CoherentSystem *system);
+
+// Sums the counters of every core into total
+void sumCoherenceStats(CoherentSystem *system, CoherenceStats *total);
+
+#endif
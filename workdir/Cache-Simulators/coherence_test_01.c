@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main_mem.h"
+#include "coherence.h"
+#include "replay.h"
+#include "trace.h"
+
+#define ADDRESS_WIDTH 16
+#define NUM_CORES 4
+#define NUM_RECORDS 20000
+#define QUANTUM 7
+
+static void checkCount(char *what, uint64_t actual, uint64_t expected) {
+    if (actual != expected) {
+        printf("%s is %llu, expected %llu\n", what, (unsigned long long) actual, (unsigned long long) expected);
+        exit(-1);
+    }
+}
+
+static uint8_t readChecked(CoherentSystem *system, uint32_t core, uint32_t address) {
+    uint8_t value;
+    if (coherentReadByte(system, core, address, &value) != SA_CACHE_SUCCESS) {
+        printf("coherentReadByte failed for core %u address 0x%x\n", core, address);
+        exit(-1);
+    }
+    return value;
+}
+
+static void writeChecked(CoherentSystem *system, uint32_t core, uint32_t address, uint8_t value) {
+    if (coherentWriteByte(system, core, address, value) != SA_CACHE_SUCCESS) {
+        printf("coherentWriteByte failed for core %u address 0x%x\n", core, address);
+        exit(-1);
+    }
+}
+
+static CoherentSystem *createSystem(MainMem *main_mem, uint32_t num_cores) {
+    CoherentSystem *system = createCoherentSystem(main_mem, num_cores, 2, 1, 2, REPL_LRU);
+    if (system == NULL) {
+        printf("createCoherentSystem failed\n");
+        exit(-1);
+    }
+    return system;
+}
+
+// Record i of core's trace: reads and writes over a 256 byte region
+// shared by every core, so blocks bounce between caches
+static TraceRecord traceRecord(uint32_t core, uint32_t i) {
+    uint32_t r = (i + 1) * 2654435761u ^ (core + 1) * 40503u;
+    r ^= r >> 13;
+    TraceRecord record;
+    record.address = (r >> 3) & 0xff;
+    record.op = (r & 3) == 0 ? TRACE_WRITE_OP : TRACE_READ_OP;
+    record.value = (uint8_t) (r >> 11);
+    record.reserved = 0;
+    return record;
+}
+
+int main() {
+    MainMem *main_mem = createMainMem(ADDRESS_WIDTH);
+    CoherentSystem *system = createSystem(main_mem, 2);
+
+    // Read sharing: the second reader finds a clean copy, nothing is invalidated
+    readChecked(system, 0, 0x00);
+    readChecked(system, 1, 0x00);
+    checkCount("bus reads", system->stats[0].bus_reads + system->stats[1].bus_reads, 2);
+    checkCount("invalidations", system->stats[0].invalidations, 0);
+
+    // Writing a Shared line upgrades it and invalidates the other copy
+    writeChecked(system, 0, 0x00, 0x5a);
+    checkCount("upgrades", system->stats[0].upgrades, 1);
+    checkCount("invalidations", system->stats[0].invalidations, 1);
+    checkCount("core 1 cache invalidations", system->cores[1]->stats.invalidations, 1);
+
+    // Reading the written word back is a true sharing miss served by core 0
+    if (readChecked(system, 1, 0x00) != 0x5a) {
+        printf("core 1 read a stale value\n");
+        exit(-1);
+    }
+    checkCount("interventions", system->stats[1].interventions, 1);
+    checkCount("true sharing misses", system->stats[1].true_sharing_misses, 1);
+    checkCount("false sharing misses", system->stats[1].false_sharing_misses, 0);
+
+    // Two cores writing different words of one block falsely share it
+    writeChecked(system, 0, 0x10, 1);
+    writeChecked(system, 1, 0x14, 2);
+    checkCount("bus read xs", system->stats[1].bus_read_xs, 1);
+    readChecked(system, 0, 0x10);
+    checkCount("false sharing misses", system->stats[0].false_sharing_misses, 1);
+    checkCount("true sharing misses", system->stats[0].true_sharing_misses, 0);
+    if (readChecked(system, 0, 0x14) != 2) {
+        printf("core 0 read a stale value\n");
+        exit(-1);
+    }
+
+    // An Exclusive line is written without an upgrade
+    readChecked(system, 0, 0x20);
+    writeChecked(system, 0, 0x20, 3);
+    checkCount("upgrades", system->stats[0].upgrades, 1);
+
+    // Evicting a Modified line writes it back
+    uint64_t write_backs = system->stats[0].write_backs;
+    for (uint32_t address=0x120; address<0x420; address+=0x100) {
+        readChecked(system, 0, address);
+    }
+    checkCount("write backs", system->stats[0].write_backs, write_backs + 1);
+    uint32_t word;
+    readWord(main_mem, 0x20, &word);
+    checkCount("written back word", word & 0xff, 3);
+
+    // A flush forgets invalidations, so the next miss is not a coherence miss
+    readChecked(system, 0, 0x40);
+    writeChecked(system, 1, 0x40, 4);
+    flushCoherentSystem(system);
+    uint64_t true_sharing = system->stats[0].true_sharing_misses;
+    readChecked(system, 0, 0x40);
+    checkCount("true sharing misses after flush", system->stats[0].true_sharing_misses, true_sharing);
+    checkCount("false sharing misses after flush", system->stats[0].false_sharing_misses, 1);
+    freeCoherentSystem(system);
+    freeMainMem(main_mem);
+
+    // Every read returns the last value written by any core, and MainMem
+    // holds every value once the caches are flushed
+    main_mem = createMainMem(ADDRESS_WIDTH);
+    system = createSystem(main_mem, NUM_CORES);
+    uint8_t shadow[256];
+    memset(shadow, 0, sizeof(shadow));
+    for (uint32_t i=0; i<NUM_RECORDS; i++) {
+        uint32_t core = i % NUM_CORES;
+        TraceRecord record = traceRecord(core, i);
+        if (record.op == TRACE_WRITE_OP) {
+            writeChecked(system, core, record.address, record.value);
+            shadow[record.address] = record.value;
+        } else if (readChecked(system, core, record.address) != shadow[record.address]) {
+            printf("core %u read a stale value at 0x%x\n", core, record.address);
+            exit(-1);
+        }
+    }
+    CoherenceStats total;
+    sumCoherenceStats(system, &total);
+    if (total.invalidations == 0 || total.interventions == 0 || total.true_sharing_misses == 0 ||
+        total.false_sharing_misses == 0) {
+        printf("shared region produced no coherence traffic\n");
+        exit(-1);
+    }
+    flushCoherentSystem(system);
+    for (uint32_t address=0; address<256; address+=4) {
+        readWord(main_mem, address, &word);
+        for (uint32_t b=0; b<4; b++) {
+            if (((word >> (8 * b)) & 0xff) != shadow[address + b]) {
+                printf("MainMem holds a stale value at 0x%x\n", address + b);
+                exit(-1);
+            }
+        }
+    }
+    freeCoherentSystem(system);
+    freeMainMem(main_mem);
+
+    // Threaded replay matches the same round-robin interleaving run on one
+    // thread, every time
+    Trace *traces[NUM_CORES];
+    for (uint32_t core=0; core<NUM_CORES; core++) {
+        char file_name[64];
+        snprintf(file_name, sizeof(file_name), "coherence_test_01-core%u.trace", core);
+        TraceWriter *writer = createTraceWriter(file_name);
+        uint32_t count = NUM_RECORDS / (core + 1);
+        for (uint32_t i=0; writer != NULL && i<count; i++) {
+            TraceRecord record = traceRecord(core, i);
+            appendTraceRecord(writer, (TraceOp) record.op, record.address, record.value);
+        }
+        if (writer == NULL || closeTraceWriter(writer) != TRACE_SUCCESS ||
+            (traces[core] = openTrace(file_name)) == NULL) {
+            printf("Cannot write trace %s\n", file_name);
+            exit(-1);
+        }
+    }
+
+    main_mem = createMainMem(ADDRESS_WIDTH);
+    system = createSystem(main_mem, NUM_CORES);
+    uint64_t positions[NUM_CORES] = {0};
+    for (uint32_t remaining=NUM_CORES; remaining>0; ) {
+        remaining = 0;
+        for (uint32_t core=0; core<NUM_CORES; core++) {
+            Trace *trace = traces[core];
+            for (uint32_t i=0; i<QUANTUM && positions[core]<trace->record_count; i++, positions[core]++) {
+                const TraceRecord *record = &trace->records[positions[core]];
+                if (record->op == TRACE_WRITE_OP) {
+                    writeChecked(system, core, record->address, record->value);
+                } else {
+                    readChecked(system, core, record->address);
+                }
+            }
+            remaining += positions[core] < trace->record_count;
+        }
+    }
+    CoherenceStats expected[NUM_CORES];
+    memcpy(expected, system->stats, sizeof(expected));
+    freeCoherentSystem(system);
+    freeMainMem(main_mem);
+
+    for (uint32_t run=0; run<3; run++) {
+        uint64_t errors[NUM_CORES];
+        main_mem = createMainMem(ADDRESS_WIDTH);
+        system = createSystem(main_mem, NUM_CORES);
+        if (replayCoherentTraces(system, traces, QUANTUM, errors) != 0) {
+            printf("replayCoherentTraces failed\n");
+            exit(-1);
+        }
+        for (uint32_t core=0; core<NUM_CORES; core++) {
+            checkCount("replay errors", errors[core], 0);
+        }
+        if (memcmp(expected, system->stats, sizeof(expected)) != 0) {
+            printf("replay %u differs from the round-robin interleaving\n", run);
+            exit(-1);
+        }
+        freeCoherentSystem(system);
+        freeMainMem(main_mem);
+    }
+    for (uint32_t core=0; core<NUM_CORES; core++) {
+        closeTrace(traces[core]);
+    }
+
+    // Core counts are limited
+    main_mem = createMainMem(ADDRESS_WIDTH);
+    if (createCoherentSystem(main_mem, COHERENCE_MAX_CORES + 1, 2, 1, 2, REPL_LRU) != NULL ||
+        createCoherentSystem(main_mem, 0, 2, 1, 2, REPL_LRU) != NULL) {
+        printf("Expected createCoherentSystem to reject the core count\n");
+        exit(-1);
+    }
+
+    // Only a write back, write allocate cache without sectors takes
+    // coherence hooks
+    SACoherence hooks = {NULL, NULL, NULL};
+    WritePolicy back = {WRITE_HIT_BACK, WRITE_MISS_ALLOCATE};
+    WritePolicy through = {WRITE_HIT_THROUGH, WRITE_MISS_ALLOCATE};
+    SACache *cache = createSACache(main_mem, 2, 1, 2);
+    setSAWritePolicy(cache, through);
+    if (attachSACoherence(cache, &hooks) == 0) {
+        printf("Expected attachSACoherence to reject a write through cache\n");
+        exit(-1);
+    }
+    setSAWritePolicy(cache, back);
+    if (enableSASectors(cache, 1) != 0 || attachSACoherence(cache, &hooks) == 0) {
+        printf("Expected attachSACoherence to reject a sectored cache\n");
+        exit(-1);
+    }
+    freeSACache(cache);
+    cache = createSACache(main_mem, 2, 1, 2);
+    setSAWritePolicy(cache, back);
+    if (attachSACoherence(cache, &hooks) != 0) {
+        printf("attachSACoherence failed\n");
+        exit(-1);
+    }
+    freeSACache(cache);
+    freeMainMem(main_mem);
+
+    printf("Coherence Test 01 Finished\n");
+}
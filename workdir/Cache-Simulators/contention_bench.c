@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "main_mem.h"
+#include "sa_cache.h"
+
+// contention_bench
+//
+// Measures how readByte/writeByte throughput of one SACache shared by
+// several threads (see enableSAConcurrentAccess) scales with the number
+// of threads. Each thread issues random byte accesses, one in four a
+// write, over a working set shared by every thread. Thread counts double
+// from 1 up to max_threads; a first row runs the same cache without
+// locks on one thread to show their cost.
+//
+// Usage: contention_bench [-n accesses] [-k shard_bits] [-w working_set_bytes] <max_threads>
+//        -n accesses per thread (default 4000000)
+//        -k log2 of the number of set locks (default one per set)
+//        -w bytes touched (default 65536, twice the 32KB cache)
+//        The cache is sa:8:2:8 (256 sets of 8 four word lines, LRU)
+//        over a MainMem without a log.
+
+#define BENCH_ADDRESS_WIDTH 24
+#define BENCH_SET_BITS 8
+#define BENCH_WORD_BITS 2
+#define BENCH_WAYS 8
+
+typedef struct BenchWorker {
+    SACache *cache;
+    uint64_t accesses;
+    uint32_t working_set;
+    uint64_t seed;
+    uint64_t errors;
+    pthread_barrier_t *start;
+    pthread_t thread;
+} BenchWorker;
+
+static double elapsedSeconds(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-n accesses] [-k shard_bits] [-w working_set_bytes] <max_threads>\n", prog);
+}
+
+static void *runBenchWorker(void *arg) {
+    BenchWorker *worker = (BenchWorker *) arg;
+    uint64_t rng = worker->seed;
+    uint8_t value;
+
+    if (worker->start != NULL) {
+        pthread_barrier_wait(worker->start);
+    }
+    for (uint64_t i = 0; i < worker->accesses; i++) {
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        uint64_t r = rng * 0x2545f4914f6cdd1dULL;
+        uint32_t address = (uint32_t) (r >> 32) % worker->working_set;
+        SACacheResult result = (r & 3) == 0 ? writeByte(worker->cache, address, (uint8_t) r)
+                                            : readByte(worker->cache, address, &value);
+        if (result != SA_CACHE_SUCCESS) {
+            worker->errors++;
+        }
+    }
+    return NULL;
+}
+
+// Runs num_threads workers on a fresh cache, with set locks unless
+// shard_bits is negative. Returns accesses per second, or -1 on error.
+static double runBench(uint32_t num_threads, int shard_bits, uint64_t accesses, uint32_t working_set,
+                       double *miss_rate) {
+    MainMem *mem = createMainMem(BENCH_ADDRESS_WIDTH);
+    SACache *cache = mem == NULL ? NULL : createSACache(mem, BENCH_SET_BITS, BENCH_WORD_BITS, BENCH_WAYS);
+    BenchWorker *workers = (BenchWorker *) calloc(num_threads, sizeof(BenchWorker));
+    if (cache == NULL || workers == NULL || (shard_bits >= 0 && enableSAConcurrentAccess(cache, shard_bits) != 0)) {
+        free(workers);
+        if (cache != NULL) {
+            freeSACache(cache);
+        }
+        if (mem != NULL) {
+            freeMainMem(mem);
+        }
+        return -1;
+    }
+    setLogMode(mem->op_log, LOG_OFF);
+
+    pthread_barrier_t start_barrier;
+    pthread_barrier_init(&start_barrier, NULL, num_threads + 1);
+    for (uint32_t t = 0; t < num_threads; t++) {
+        workers[t].cache = cache;
+        workers[t].accesses = accesses;
+        workers[t].working_set = working_set;
+        workers[t].seed = 0x9e3779b97f4a7c15ULL * (t + 1);
+        workers[t].start = &start_barrier;
+        if (pthread_create(&workers[t].thread, NULL, runBenchWorker, &workers[t]) != 0) {
+            fprintf(stderr, "cannot start thread %u\n", t);
+            exit(1);
+        }
+    }
+
+    struct timespec start, end;
+    pthread_barrier_wait(&start_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t errors = 0;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        errors += workers[t].errors;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&start_barrier);
+
+    flushCache(cache);
+    CacheStats *stats = &cache->stats;
+    *miss_rate = stats->hits + stats->misses > 0 ? (double) stats->misses / (stats->hits + stats->misses) : 0.0;
+    freeSACache(cache);
+    freeMainMem(mem);
+    free(workers);
+    if (errors != 0) {
+        fprintf(stderr, "%llu accesses failed\n", (unsigned long long) errors);
+        return -1;
+    }
+    return (double) accesses * num_threads / elapsedSeconds(&start, &end);
+}
+
+int main(int argc, char **argv) {
+    uint64_t accesses = 4000000;
+    int shard_bits = BENCH_SET_BITS;
+    uint32_t working_set = 65536;
+    int argi = 1;
+
+    while (argi + 1 < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-n") == 0) {
+            accesses = strtoull(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "-k") == 0) {
+            shard_bits = atoi(argv[argi + 1]);
+        } else if (strcmp(argv[argi], "-w") == 0) {
+            working_set = (uint32_t) strtoul(argv[argi + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        argi += 2;
+    }
+    if (argc - argi != 1 || shard_bits < 0 || shard_bits > BENCH_SET_BITS || working_set == 0 ||
+        working_set > (1u << BENCH_ADDRESS_WIDTH)) {
+        usage(argv[0]);
+        return 1;
+    }
+    uint32_t max_threads = (uint32_t) strtoul(argv[argi], NULL, 10);
+    if (max_threads == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("sa:%u:%u:%u, %u set locks, %u byte working set, %llu accesses per thread\n", BENCH_SET_BITS,
+           BENCH_WORD_BITS, BENCH_WAYS, 1u << shard_bits, working_set, (unsigned long long) accesses);
+    printf("%-8s %14s %9s %9s\n", "threads", "accesses/s", "speedup", "miss_rate");
+
+    double miss_rate;
+    double unlocked = runBench(1, -1, accesses, working_set, &miss_rate);
+    if (unlocked < 0) {
+        return 1;
+    }
+    printf("%-8s %14.0f %9.2f %9.5f\n", "nolock", unlocked, 1.0, miss_rate);
+    for (uint32_t threads = 1; threads <= max_threads; threads *= 2) {
+        double rate = runBench(threads, shard_bits, accesses, working_set, &miss_rate);
+        if (rate < 0) {
+            return 1;
+        }
+        printf("%-8u %14.0f %9.2f %9.5f\n", threads, rate, rate / unlocked, miss_rate);
+        if (threads > max_threads / 2 && threads != max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+    return 0;
+}
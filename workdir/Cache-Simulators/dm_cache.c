@@ -1,7 +1,17 @@
 // PID: 730384155
 // I pledge the COMP 211 honor code.
+#include <string.h>
 #include "dm_cache.h"
 
+// Backing store callbacks, defined below
+static int dmReadStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty);
+static int dmWriteStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind);
+static void dmInvalidateStore(void *impl, uint32_t address, uint32_t count);
+
+// Bodies of readByte and writeByte, defined below
+static DMCacheResult readLine(DMCache *cache, uint32_t address, uint8_t *value);
+static DMCacheResult writeLine(DMCache *cache, uint32_t address, uint8_t value);
+
 DMCache *createDMCache(MainMem *mem,
                      uint32_t set_index_bitcount,
                      uint32_t word_index_bitcount) {
@@ -22,8 +32,10 @@ DMCache *createDMCache(MainMem *mem,
     uint32_t num_lines = (1<<set_index_bitcount);
     cache->lines = (DMCacheLine *) calloc(num_lines, sizeof(DMCacheLine));
     
-    if (cache->lines == NULL){
+    if (cache->lines == NULL || initCacheStats(&cache->stats, num_lines) != 0){
+        free(cache->lines);
         free(cache);
+        return NULL;
     }
 
     for (uint32_t i=0; i<num_lines; i++){
@@ -33,68 +45,275 @@ DMCache *createDMCache(MainMem *mem,
             for (uint32_t k=0; k<i;k++) {
                 free(cache->lines[i].block);
             }
+            freeCacheStats(&cache->stats);
             free(cache->lines);
             free(cache);
             return NULL;
         }
         cache->lines[i].valid = 0;
+        cache->lines[i].dirty = 0;
     }
     cache->word_index_bitcount = word_index_bitcount;
     cache->set_index_bitcount = set_index_bitcount;
     cache->mem = mem;
     cache->lines = cache->lines;
+    cache->classifier = NULL;
+
+    cache->store.impl = cache;
+    cache->store.address_width = mem->address_width;
+    cache->store.block_words = 1 << word_index_bitcount;
+    cache->store.write_back = 0;
+    cache->store.inclusion = INCLUSION_NON_INCLUSIVE;
+    cache->store.next = &mem->store;
+    cache->store.above = NULL;
+    cache->store.read_block = dmReadStore;
+    cache->store.write_block = dmWriteStore;
+    cache->store.invalidate_block = dmInvalidateStore;
+    cache->write_policy.hit = WRITE_HIT_THROUGH;
+    cache->write_policy.miss = WRITE_MISS_NO_ALLOCATE;
 
     return cache;
 }
 
+void setDMWritePolicy(DMCache *cache, WritePolicy policy) {
+    cache->write_policy = policy;
+    cache->store.write_back = policy.hit == WRITE_HIT_BACK;
+}
+
+int enableDMMissClassification(DMCache *cache) {
+    if (cache->classifier != NULL) {
+        return 0;
+    }
+    uint32_t block_bits = cache->mem->address_width - cache->word_index_bitcount - 2;
+    cache->classifier = createMissClassifier(1 << cache->set_index_bitcount, (uint32_t) (1ULL << block_bits));
+    return cache->classifier != NULL ? 0 : -1;
+}
+
 void freeDMCache(DMCache *cache) {
     for (uint32_t i=0; i<(1<<cache->set_index_bitcount);i++){
         free(cache->lines[i].block);
     }
+    freeMissClassifier(cache->classifier);
+    freeCacheStats(&cache->stats);
     free(cache->lines);
     free(cache);
 }
 
-uint32_t bit_select(uint32_t num, uint32_t startbit, uint32_t endbit) {
+static uint32_t bit_select(uint32_t num, uint32_t startbit, uint32_t endbit) {
      uint32_t topmask = 0xffffffff;
     return (num >> endbit) & (~(topmask << (startbit-endbit+1)));
 }
 
-DMCacheResult readByte(DMCache *cache, uint32_t address, uint8_t *value) {
-    if (cache == NULL) {
-        return DM_INVALID_CACHE;
+// Returns line that address maps to and stores its tag in addr_tag
+static DMCacheLine *mapLine(DMCache *cache, uint32_t address, uint32_t *addr_tag) {
+    uint32_t line_index_start = 1+cache->word_index_bitcount+cache->set_index_bitcount;
+    uint32_t line_index_end = 2+cache->word_index_bitcount;
+    uint32_t line_index = bit_select(address, line_index_start, line_index_end);
+
+    *addr_tag = address >> (cache->set_index_bitcount + cache->word_index_bitcount + 2);
+    return &cache->lines[line_index];
+}
+
+// Returns byte address of the block held by line
+static uint32_t lineAddress(DMCache *cache, DMCacheLine *line) {
+    uint32_t line_index = (uint32_t) (line - cache->lines);
+    return (line->tag << (cache->set_index_bitcount + cache->word_index_bitcount + 2)) |
+           (line_index << (cache->word_index_bitcount + 2));
+}
+
+// Writes line back to the level below if it is dirty
+static void writeBackLine(DMCache *cache, DMCacheLine *line) {
+    if (line->dirty) {
+        BackingStore *next = cache->store.next;
+        next->write_block(next->impl, lineAddress(cache, line), line->block,
+                          1 << cache->word_index_bitcount, STORE_WRITE_BACK);
+        line->dirty = 0;
+        cache->stats.write_backs++;
     }
+}
 
-    if (address >= (1 << cache->mem->address_width)) {
-        return DM_CACHE_ADDRESS_OUT_OF_RANGE;
+// Removes line from the cache. An inclusive cache first invalidates the
+// block above, which writes any dirty copy into line. The block is then
+// written back if dirty, or handed to an exclusive level below if clean.
+static void evictLine(DMCache *cache, DMCacheLine *line) {
+    BackingStore *above = cache->store.above;
+    BackingStore *next = cache->store.next;
+    uint32_t old_addr = lineAddress(cache, line);
+    if (cache->store.inclusion == INCLUSION_INCLUSIVE && above != NULL) {
+        above->invalidate_block(above->impl, old_addr, 1 << cache->word_index_bitcount);
+    }
+    if (line->dirty) {
+        writeBackLine(cache, line);
+    } else if (next->inclusion == INCLUSION_EXCLUSIVE) {
+        next->write_block(next->impl, old_addr, line->block, 1 << cache->word_index_bitcount,
+                          STORE_CLEAN_VICTIM);
     }
+    line->valid = 0;
+}
 
-    if (value == NULL) {
-        return DM_INVALID_VALUE_PTR;
+// Counts access of address to line_index in stats, classifying a miss
+// if the cache classifies misses
+static void countDemand(DMCache *cache, uint32_t line_index, uint32_t address, StatsAccess access, int hit) {
+    countAccess(&cache->stats, line_index, access, hit);
+    if (cache->classifier != NULL && access != STATS_NO_ACCESS) {
+        classifyAccess(cache->classifier, &cache->stats, address >> (cache->word_index_bitcount + 2), hit);
     }
-    uint32_t line_index_start = 1+cache->word_index_bitcount+cache->set_index_bitcount;
-    uint32_t line_index_end = 2+cache->word_index_bitcount;
-    uint32_t line_index = bit_select(address, line_index_start, line_index_end);
+}
 
-    DMCacheLine *line = &cache->lines[line_index];
-    
-    uint32_t addr_tag = address >> (cache->set_index_bitcount + cache->word_index_bitcount + 2);
+// Returns line holding address, filling it from the level below on a
+// miss unless fill is zero, in which case the caller overwrites the whole
+// block. The replaced block is evicted with evictLine. access is counted
+// in stats. Returns NULL if the block cannot be read.
+static DMCacheLine *lookupLine(DMCache *cache, uint32_t address, uint32_t fill, StatsAccess access) {
+    uint32_t addr_tag;
+    DMCacheLine *line = mapLine(cache, address, &addr_tag);
+    uint32_t line_index = (uint32_t) (line - cache->lines);
 
+    countDemand(cache, line_index, address, access, line->valid && line->tag == addr_tag);
     if ((!line->valid) || (line->tag != addr_tag)) {
         // Line does not have the block we want. Go get it.
-        
+        if (line->valid) {
+            evictLine(cache, line);
+            countEviction(&cache->stats, line_index);
+        }
+
         uint32_t block_start_address = address & (0xffffffff << (cache->word_index_bitcount+2));
         uint32_t block_size = (1 << cache->word_index_bitcount);
-        for (uint32_t i=0; i<block_size; i++) {
-            if (!(readWord(cache->mem, block_start_address + (i*sizeof(uint32_t)), &(line->block[i])) == MM_SUCCESS)) {
-                return DM_UNIT_FAIL;
-            }
+        uint8_t dirty = 0;
+        BackingStore *next = cache->store.next;
+        if (fill && next->read_block(next->impl, block_start_address, line->block, block_size, &dirty) != 0) {
+            return NULL;
+        }
+        if (fill) {
+            cache->stats.fills++;
         }
         line->valid = 1;
+        line->dirty = dirty;
         line->tag = addr_tag;
-   }
+    }
+    return line;
+}
+
+//----------------------
+// Backing store callbacks used by the level above (see backing_store.h)
+
+static int dmReadStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty) {
+    DMCache *cache = (DMCache *) impl;
+    uint32_t offset = (address >> 2) & ((1 << cache->word_index_bitcount) - 1);
+    DMCacheLine *line;
+
+    *dirty = 0;
+    if (cache->store.inclusion == INCLUSION_EXCLUSIVE) {
+        // Hand the block up and forget it, or pass the miss through. A
+        // read of part of a block (a no allocate write merging a byte)
+        // leaves the block here for the write that follows.
+        uint32_t addr_tag;
+        line = mapLine(cache, address, &addr_tag);
+        int hit = line->valid && line->tag == addr_tag;
+        countDemand(cache, (uint32_t) (line - cache->lines), address, STATS_READ, hit);
+        if (!hit) {
+            BackingStore *next = cache->store.next;
+            return next->read_block(next->impl, address, values, count, dirty);
+        }
+        memcpy(values, line->block + offset, count * sizeof(uint32_t));
+        if (count != 1u << cache->word_index_bitcount) {
+            return 0;
+        }
+        *dirty = (uint8_t) line->dirty;
+        line->valid = 0;
+        line->dirty = 0;
+        cache->stats.invalidations++;
+        return 0;
+    }
+
+    line = lookupLine(cache, address, 1, STATS_READ);
+    if (line == NULL) {
+        return -1;
+    }
+    memcpy(values, line->block + offset, count * sizeof(uint32_t));
+    return 0;
+}
+
+static int dmWriteStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind) {
+    DMCache *cache = (DMCache *) impl;
+    uint32_t block_words = 1 << cache->word_index_bitcount;
+    uint32_t offset = (address >> 2) & (block_words - 1);
+    BackingStore *next = cache->store.next;
+    DMCacheLine *line;
+
+    if (kind == STORE_CLEAN_VICTIM ||
+        (kind == STORE_WRITE_BACK && cache->write_policy.miss == WRITE_MISS_ALLOCATE)) {
+        line = lookupLine(cache, address, count != block_words,
+                          kind == STORE_CLEAN_VICTIM ? STATS_NO_ACCESS : STATS_WRITE);
+        if (line == NULL) {
+            return -1;
+        }
+    } else {
+        // Update a resident block, otherwise pass the words down
+        uint32_t addr_tag;
+        line = mapLine(cache, address, &addr_tag);
+        int hit = line->valid && line->tag == addr_tag;
+        countDemand(cache, (uint32_t) (line - cache->lines), address, STATS_WRITE, hit);
+        if (!hit) {
+            return next->write_block(next->impl, address, values, count, kind);
+        }
+    }
+
+    memcpy(line->block + offset, values, count * sizeof(uint32_t));
+    if (kind == STORE_CLEAN_VICTIM) {
+        return 0;
+    }
+    if (cache->write_policy.hit == WRITE_HIT_THROUGH) {
+        return next->write_block(next->impl, address, values, count, kind);
+    }
+    line->dirty = 1;
+    return 0;
+}
+
+static void dmInvalidateStore(void *impl, uint32_t address, uint32_t count) {
+    DMCache *cache = (DMCache *) impl;
+    uint32_t block_bytes = 4 << cache->word_index_bitcount;
+    uint64_t end = (uint64_t) address + count * sizeof(uint32_t);
+
+    for (uint64_t block_addr = address; block_addr < end; block_addr += block_bytes) {
+        uint32_t addr_tag;
+        DMCacheLine *line = mapLine(cache, (uint32_t) block_addr, &addr_tag);
+        if (line->valid && line->tag == addr_tag) {
+            BackingStore *above = cache->store.above;
+            if (cache->store.inclusion == INCLUSION_INCLUSIVE && above != NULL) {
+                above->invalidate_block(above->impl, (uint32_t) block_addr, block_bytes / sizeof(uint32_t));
+            }
+            writeBackLine(cache, line);
+            line->valid = 0;
+            cache->stats.invalidations++;
+        }
+    }
+}
+
+DMCacheResult readByte(DMCache *cache, uint32_t address, uint8_t *value) {
+    if (cache == NULL) {
+        return DM_INVALID_CACHE;
+    }
+
+    if ((uint64_t) address >= (1ULL << cache->mem->address_width)) {
+        return DM_CACHE_ADDRESS_OUT_OF_RANGE;
+    }
+
+    if (value == NULL) {
+        return DM_INVALID_VALUE_PTR;
+    }
+
+    return readLine(cache, address, value);
+}
+
+// Body of readByte
+static DMCacheResult readLine(DMCache *cache, uint32_t address, uint8_t *value) {
+    DMCacheLine *line = lookupLine(cache, address, 1, STATS_READ);
+    if (line == NULL) {
+        return DM_UNIT_FAIL;
+    }
     
-   uint32_t word_index = bit_select(address, 2+cache->word_index_bitcount-1, 2);
+   uint32_t word_index = (address >> 2) & ((1 << cache->word_index_bitcount) - 1);
    uint32_t word = line->block[word_index];
 
    uint32_t byte_offset = address & 0x3;
@@ -104,5 +323,142 @@ DMCacheResult readByte(DMCache *cache, uint32_t address, uint8_t *value) {
    return DM_CACHE_SUCCESS;
 }
 
+// Writes value at address to the level below without allocating. A
+// resident line (write around) is updated and evicted, which writes it
+// back if dirty; a clean one has just the written word written through.
+static DMCacheResult writeAround(DMCache *cache, uint32_t address, uint8_t value, DMCacheLine *line) {
+    BackingStore *next = cache->store.next;
+    if (line == NULL) {
+        return storeWriteByte(next, address, value) == 0 ? DM_CACHE_SUCCESS : DM_UNIT_FAIL;
+    }
 
+    uint32_t *word = &line->block[(address >> 2) & ((1 << cache->word_index_bitcount) - 1)];
+    *word = mergeByte(*word, address, value);
+    int status = 0;
+    if (!line->dirty) {
+        status = next->write_block(next->impl, address & ~(uint32_t) 3, word, 1, STORE_WRITE_THROUGH);
+    }
+    evictLine(cache, line);
+    countEviction(&cache->stats, (uint32_t) (line - cache->lines));
+    return status == 0 ? DM_CACHE_SUCCESS : DM_UNIT_FAIL;
+}
 
+DMCacheResult writeByte(DMCache *cache, uint32_t address, uint8_t value) {
+    if (cache == NULL) {
+        return DM_INVALID_CACHE;
+    }
+
+    if ((uint64_t) address >= (1ULL << cache->mem->address_width)) {
+        return DM_CACHE_ADDRESS_OUT_OF_RANGE;
+    }
+
+    return writeLine(cache, address, value);
+}
+
+// Body of writeByte
+static DMCacheResult writeLine(DMCache *cache, uint32_t address, uint8_t value) {
+    if (cache->write_policy.miss != WRITE_MISS_ALLOCATE) {
+        uint32_t addr_tag;
+        DMCacheLine *line = mapLine(cache, address, &addr_tag);
+        int hit = line->valid && line->tag == addr_tag;
+        if (!hit || cache->write_policy.miss == WRITE_MISS_AROUND) {
+            countDemand(cache, (uint32_t) (line - cache->lines), address, STATS_WRITE, hit);
+            return writeAround(cache, address, value, hit ? line : NULL);
+        }
+    }
+
+    DMCacheLine *line = lookupLine(cache, address, 1, STATS_WRITE);
+    if (line == NULL) {
+        return DM_UNIT_FAIL;
+    }
+
+    uint32_t *word = &line->block[(address >> 2) & ((1 << cache->word_index_bitcount) - 1)];
+    *word = mergeByte(*word, address, value);
+    if (cache->write_policy.hit == WRITE_HIT_BACK) {
+        line->dirty = 1;
+    } else {
+        BackingStore *next = cache->store.next;
+        if (next->write_block(next->impl, address & ~(uint32_t) 3, word, 1, STORE_WRITE_THROUGH) != 0) {
+            return DM_UNIT_FAIL;
+        }
+    }
+    return DM_CACHE_SUCCESS;
+}
+
+// Prefetches the line addresses[i] maps to, if i < count
+static inline void prefetchMapped(DMCache *cache, const uint32_t *addresses, uint32_t i, uint32_t count) {
+    if (i < count) {
+        uint32_t line_index = (addresses[i] >> (cache->word_index_bitcount + 2)) &
+                              ((1 << cache->set_index_bitcount) - 1);
+        __builtin_prefetch(&cache->lines[line_index]);
+    }
+}
+
+DMCacheResult readBytes(DMCache *cache, const uint32_t *addresses, uint8_t *values,
+                        uint32_t count, uint32_t *errors) {
+    if (cache == NULL) {
+        return DM_INVALID_CACHE;
+    }
+
+    if (count > 0 && (addresses == NULL || values == NULL)) {
+        return DM_INVALID_VALUE_PTR;
+    }
+
+    uint64_t limit = 1ULL << cache->mem->address_width;
+    DMCacheResult first = DM_CACHE_SUCCESS;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        prefetchMapped(cache, addresses, i + BATCH_PREFETCH_DISTANCE, count);
+        DMCacheResult result = addresses[i] < limit ? readLine(cache, addresses[i], &values[i])
+                                                    : DM_CACHE_ADDRESS_OUT_OF_RANGE;
+        if (result != DM_CACHE_SUCCESS && failed++ == 0) {
+            first = result;
+        }
+    }
+    if (errors != NULL) {
+        *errors = failed;
+    }
+    return first;
+}
+
+DMCacheResult writeBytes(DMCache *cache, const uint32_t *addresses, const uint8_t *values,
+                         uint32_t count, uint32_t *errors) {
+    if (cache == NULL) {
+        return DM_INVALID_CACHE;
+    }
+
+    if (count > 0 && (addresses == NULL || values == NULL)) {
+        return DM_INVALID_VALUE_PTR;
+    }
+
+    uint64_t limit = 1ULL << cache->mem->address_width;
+    DMCacheResult first = DM_CACHE_SUCCESS;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        prefetchMapped(cache, addresses, i + BATCH_PREFETCH_DISTANCE, count);
+        DMCacheResult result = addresses[i] < limit ? writeLine(cache, addresses[i], values[i])
+                                                    : DM_CACHE_ADDRESS_OUT_OF_RANGE;
+        if (result != DM_CACHE_SUCCESS && failed++ == 0) {
+            first = result;
+        }
+    }
+    if (errors != NULL) {
+        *errors = failed;
+    }
+    return first;
+}
+
+void flushDMCache(DMCache *cache) {
+    BackingStore *above = cache->store.above;
+    for (uint32_t i = 0; i < (1u << cache->set_index_bitcount); i++) {
+        DMCacheLine *line = &cache->lines[i];
+        if (!line->valid) {
+            continue;
+        }
+        if (cache->store.inclusion == INCLUSION_INCLUSIVE && above != NULL) {
+            above->invalidate_block(above->impl, lineAddress(cache, line), 1 << cache->word_index_bitcount);
+        }
+        writeBackLine(cache, line);
+        line->valid = 0;
+    }
+}
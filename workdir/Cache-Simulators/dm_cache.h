@@ -4,15 +4,27 @@
 #define DM_CACHE_H
 #include <stdint.h>
 #include "main_mem.h"
+#include "cache_stats.h"
+#include "miss_class.h"
 
 // DMCache
 // 
-// Models a direct mapped read-only cache in front of a main memory model.
-// Provides byte-level read interface.
+// Models a direct mapped cache in front of a main memory model.
+// Provides byte-level read/write interface. Writes are write through, no write
+// allocate unless changed with setDMWritePolicy, so by default a write updates
+// a resident copy and passes straight through.
+//
+// Fills and writes go through store.next, which is mem's BackingStore unless
+// the cache is stacked on another level with linkBackingStores.
+//
+// stats (cache_stats.h) counts each line as a set. Misses are also
+// classified as compulsory, capacity or conflict once
+// enableDMMissClassification is called.
 typedef struct DMCacheLine {
     uint32_t valid;
     uint32_t tag;
     uint32_t *block;
+    uint32_t dirty;         // Only ever set in a write back cache
 } DMCacheLine;
 
 typedef struct DMCache {
@@ -20,6 +32,10 @@ typedef struct DMCache {
     uint32_t set_index_bitcount;
     MainMem *mem;
     DMCacheLine *lines;
+    BackingStore store;     // This cache as seen by the level above; store.next is the level below
+    WritePolicy write_policy;
+    CacheStats stats;
+    MissClassifier *classifier; // NULL unless enabled with enableDMMissClassification
 } DMCache;
 
 // Enum for result codes returned by readByte
@@ -50,6 +66,24 @@ DMCache *createDMCache(MainMem *mem,                // Underlying MainMem model.
                    uint32_t set_index_bitcount,     // Number of set index bits 
                    uint32_t word_index_bitcount);   // Number of word index bits
 
+// setDMWritePolicy
+// Sets the write hit and miss policies of cache (see backing_store.h).
+// Writes from the level above follow them as in setSAWritePolicy. Must
+// be called before the cache is linked below another level.
+
+void setDMWritePolicy(DMCache *cache, WritePolicy policy);
+
+// enableDMMissClassification
+// Starts classifying the misses of cache (see miss_class.h) into its
+// stats. Returns 0 on success, -1 if the classifier cannot be created.
+
+int enableDMMissClassification(DMCache *cache);
+
+// flushDMCache
+// Writes back any dirty cache lines and invalidates all cache lines.
+
+void flushDMCache(DMCache *cache);
+
 // freeDMCache
 // Frees the memory used by cache.
 void freeDMCache(DMCache *cache);
@@ -63,4 +97,31 @@ void freeDMCache(DMCache *cache);
 
 DMCacheResult readByte(DMCache *cache, uint32_t address, uint8_t *value);
 
+// writeByte
+// Writes byte with value at address provided.
+// Returns one of the following DMCacheResult symbols:
+// DM_SUCCESS - returned when successful
+// DM_INVALID_CACHE - returned if cache parameter is NULL
+// DM_ADDRESS_OUT_OF_RANGE - returned if address not within range
+
+DMCacheResult writeByte(DMCache *cache, uint32_t address, uint8_t value);
+
+// readBytes
+// Reads the byte at each of count addresses into values, in order, as
+// count calls of readByte would. cache and the arrays are checked once,
+// returning DM_INVALID_CACHE or DM_INVALID_VALUE_PTR before any read.
+// Returns DM_CACHE_SUCCESS if every read succeeded, otherwise the result
+// of the first that failed; the reads after it are still performed.
+// errors, if not NULL, receives the number of reads that failed.
+
+DMCacheResult readBytes(DMCache *cache, const uint32_t *addresses, uint8_t *values,
+                        uint32_t count, uint32_t *errors);
+
+// writeBytes
+// Writes values[i] at addresses[i] for each of count addresses, in order,
+// as count calls of writeByte would. Returns as readBytes.
+
+DMCacheResult writeBytes(DMCache *cache, const uint32_t *addresses, const uint8_t *values,
+                         uint32_t count, uint32_t *errors);
+
 #endif
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include "dm_cache.h"
+#include "cache_model.h"
+
+// Adapter exposing DMCache through the CacheModel interface.
+// Compiled with DM_NAMESPACE (see Makefile).
+
+static int dmReadByteModel(void *cache, uint32_t address, uint8_t *value) {
+    return readByte((DMCache *) cache, address, value);
+}
+
+static int dmWriteByteModel(void *cache, uint32_t address, uint8_t value) {
+    return writeByte((DMCache *) cache, address, value);
+}
+
+static int dmReadBytesModel(void *cache, const uint32_t *addresses, uint8_t *values, uint32_t count,
+                            uint32_t *errors) {
+    return readBytes((DMCache *) cache, addresses, values, count, errors);
+}
+
+static int dmWriteBytesModel(void *cache, const uint32_t *addresses, const uint8_t *values, uint32_t count,
+                             uint32_t *errors) {
+    return writeBytes((DMCache *) cache, addresses, values, count, errors);
+}
+
+static void dmFlushModel(void *cache) {
+    flushDMCache((DMCache *) cache);
+}
+
+static void dmFreeModel(void *cache) {
+    freeDMCache((DMCache *) cache);
+}
+
+CacheModel *createDMCacheModel(MainMem *mem, CacheConfig *config) {
+    CacheModel *model = (CacheModel *) malloc(sizeof(CacheModel));
+    if (model == NULL) {
+        return NULL;
+    }
+
+    model->cache = createDMCache(mem, config->set_index_bitcount, config->word_index_bitcount);
+    if (model->cache == NULL) {
+        free(model);
+        return NULL;
+    }
+    setDMWritePolicy((DMCache *) model->cache, config->write_policy);
+    if (config->classify_misses && enableDMMissClassification((DMCache *) model->cache) != 0) {
+        freeDMCache((DMCache *) model->cache);
+        free(model);
+        return NULL;
+    }
+
+    model->config = *config;
+    model->mem = mem;
+    model->read_byte = dmReadByteModel;
+    model->write_byte = dmWriteByteModel;
+    model->read_bytes = dmReadBytesModel;
+    model->write_bytes = dmWriteBytesModel;
+    model->flush = dmFlushModel;
+    model->free_cache = dmFreeModel;
+    model->store = &((DMCache *) model->cache)->store;
+    model->stats = &((DMCache *) model->cache)->stats;
+    model->prefetch_stats = NULL;
+    model->write_buffer_stats = NULL;
+    model->lower = NULL;
+    return model;
+}
@@ -1,11 +1,29 @@
 // PID: 730384155
 // I pledge the COMP 211 honor code.
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "fa_cache.h"
 
+// Backing store callbacks, defined below
+static int faReadStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty);
+static int faWriteStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind);
+static void faInvalidateStore(void *impl, uint32_t address, uint32_t count);
+
+// Bodies of readByte and writeByte, defined below
+static FACacheResult readLine(FACache *cache, uint32_t address, uint8_t *value);
+static FACacheResult writeLine(FACache *cache, uint32_t address, uint8_t value);
+
 FACache *createFACache(MainMem *mem,
                      uint32_t word_index_bitcount,
                      uint32_t num_cache_lines) {
+    return createFACacheWithPolicy(mem, word_index_bitcount, num_cache_lines, REPL_LRU);
+}
+
+FACache *createFACacheWithPolicy(MainMem *mem,
+                                 uint32_t word_index_bitcount,
+                                 uint32_t num_cache_lines,
+                                 ReplacementType policy) {
     if (mem == NULL){
         return NULL;
     }
@@ -29,14 +47,42 @@ FACache *createFACache(MainMem *mem,
         return NULL;
     }
 
+    // At least twice as many buckets as lines keeps probe runs short
+    uint32_t hash_bits = 1;
+    while ((1ULL << hash_bits) < 2ULL * num_cache_lines) {
+        hash_bits++;
+    }
+    uint32_t *hash_tags = (uint32_t *) calloc(1ULL << hash_bits, sizeof(uint32_t));
+    uint32_t *hash_lines = (uint32_t *) malloc((1ULL << hash_bits) * sizeof(uint32_t));
+    uint32_t *free_lines = (uint32_t *) malloc(num_cache_lines * sizeof(uint32_t));
+    ReplacementPolicy *repl = createReplacementPolicy(policy, 1, num_cache_lines);
+    if (hash_tags == NULL || hash_lines == NULL || free_lines == NULL || repl == NULL ||
+        initCacheStats(&cache->stats, 1) != 0) {
+        freeReplacementPolicy(repl);
+        free(free_lines);
+        free(hash_tags);
+        free(hash_lines);
+        free(buff);
+        free(cache);
+        return NULL;
+    }
+    memset(hash_lines, 0xff, (1ULL << hash_bits) * sizeof(uint32_t));
+
     for (uint32_t i=0; i<num_cache_lines; i++){
+        // Popped from the end, so lines fill in index order
+        free_lines[i] = num_cache_lines - 1 - i;
         buff[i].valid = 0;
-        buff[i].use_identification = 0;
+        buff[i].dirty = 0;
         buff[i].block = (uint32_t *) calloc((1<<word_index_bitcount), sizeof(uint32_t));
         if (buff[i].block == NULL){
             for (uint32_t k=0;k<i;k++) {
                 free(buff[k].block);
             }
+            freeCacheStats(&cache->stats);
+            freeReplacementPolicy(repl);
+            free(free_lines);
+            free(hash_tags);
+            free(hash_lines);
             free(buff);
             free(cache);
             return NULL;
@@ -47,21 +93,307 @@ FACache *createFACache(MainMem *mem,
     cache->mem = mem;
     cache->num_cache_lines = num_cache_lines;
     cache->lines = buff;
-    cache->use_count = 0;
+    cache->policy = repl;
+    cache->free_lines = free_lines;
+    cache->free_count = num_cache_lines;
+    cache->hash_shift = 32 - hash_bits;
+    cache->hash_mask = (1u << hash_bits) - 1;
+    cache->hash_tags = hash_tags;
+    cache->hash_lines = hash_lines;
+    cache->write_buffer = NULL;
+
+    cache->store.impl = cache;
+    cache->store.address_width = mem->address_width;
+    cache->store.block_words = 1 << word_index_bitcount;
+    cache->store.write_back = 0;
+    cache->store.inclusion = INCLUSION_NON_INCLUSIVE;
+    cache->store.next = &mem->store;
+    cache->store.above = NULL;
+    cache->store.read_block = faReadStore;
+    cache->store.write_block = faWriteStore;
+    cache->store.invalidate_block = faInvalidateStore;
+    cache->write_policy.hit = WRITE_HIT_THROUGH;
+    cache->write_policy.miss = WRITE_MISS_ALLOCATE;
 
     return cache;
     
 }
 
+void setFAWritePolicy(FACache *cache, WritePolicy policy) {
+    cache->write_policy = policy;
+    cache->store.write_back = policy.hit == WRITE_HIT_BACK;
+}
+
+int attachFAWriteBuffer(FACache *cache, uint32_t num_entries) {
+    WriteBuffer *buffer = createWriteBuffer(num_entries, 1 << cache->word_index_bitcount);
+    if (buffer == NULL) {
+        return -1;
+    }
+    drainFAWriteBuffer(cache);
+    freeWriteBuffer(cache->write_buffer);
+    cache->write_buffer = buffer;
+    return 0;
+}
+
+FACacheResult drainFAWriteBuffer(FACache *cache) {
+    if (cache->write_buffer != NULL && drainWriteBuffer(cache->write_buffer, cache->store.next) != 0) {
+        return FA_UNIT_FAIL;
+    }
+    return FA_CACHE_SUCCESS;
+}
+
 void freeFACache(FACache *cache) {
+    freeWriteBuffer(cache->write_buffer);
+    freeCacheStats(&cache->stats);
     for (uint32_t i=0; i<cache->num_cache_lines; i++) {
         free(cache->lines[i].block);
     }
+    freeReplacementPolicy(cache->policy);
+    free(cache->free_lines);
+    free(cache->hash_tags);
+    free(cache->hash_lines);
     free(cache->lines);
     free(cache);
 }
 
-uint32_t bit_select(uint32_t num, uint32_t startbit, uint32_t endbit) {
+// Returns bucket holding tag, or the empty bucket where it would go
+static uint32_t hashFind(FACache *cache, uint32_t tag) {
+    uint32_t i = (tag * 2654435761u) >> cache->hash_shift;
+    while (cache->hash_lines[i] != FA_NO_LINE && cache->hash_tags[i] != tag) {
+        i = (i + 1) & cache->hash_mask;
+    }
+    return i;
+}
+
+// Removes bucket i, shifting later entries of the probe run back
+static void hashRemove(FACache *cache, uint32_t i) {
+    uint32_t j = i;
+    for (;;) {
+        j = (j + 1) & cache->hash_mask;
+        if (cache->hash_lines[j] == FA_NO_LINE) {
+            break;
+        }
+        uint32_t k = (cache->hash_tags[j] * 2654435761u) >> cache->hash_shift;
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        cache->hash_tags[i] = cache->hash_tags[j];
+        cache->hash_lines[i] = cache->hash_lines[j];
+        i = j;
+    }
+    cache->hash_lines[i] = FA_NO_LINE;
+}
+
+// Forgets line idx without writing it anywhere
+static void dropLine(FACache *cache, uint32_t idx) {
+    FACacheLine *line = &cache->lines[idx];
+    hashRemove(cache, hashFind(cache, line->tag));
+    line->valid = 0;
+    line->dirty = 0;
+    cache->free_lines[cache->free_count++] = idx;
+}
+
+// Writes line idx back to the level below if it is dirty. Buffered words
+// of the block are older, so they are drained first.
+static int writeBackLine(FACache *cache, uint32_t idx) {
+    FACacheLine *line = &cache->lines[idx];
+    if (!line->dirty) {
+        return 0;
+    }
+    uint32_t block_addr = line->tag << (cache->word_index_bitcount + 2);
+    BackingStore *next = cache->store.next;
+    if (cache->write_buffer != NULL && drainWriteBufferBlock(cache->write_buffer, next, block_addr) != 0) {
+        return -1;
+    }
+    line->dirty = 0;
+    cache->stats.write_backs++;
+    return next->write_block(next->impl, block_addr, line->block, 1 << cache->word_index_bitcount,
+                             STORE_WRITE_BACK);
+}
+
+// Drops line idx from the cache. An inclusive cache first invalidates the
+// block above, which writes any dirty copy into the line. The block is
+// then written back if dirty, or handed to an exclusive level below if
+// clean. Callers count the eviction or invalidation.
+static void evictLine(FACache *cache, uint32_t idx) {
+    FACacheLine *line = &cache->lines[idx];
+    uint32_t block_addr = line->tag << (cache->word_index_bitcount + 2);
+    BackingStore *above = cache->store.above;
+    BackingStore *next = cache->store.next;
+    if (cache->store.inclusion == INCLUSION_INCLUSIVE && above != NULL) {
+        above->invalidate_block(above->impl, block_addr, 1 << cache->word_index_bitcount);
+    }
+    if (line->dirty) {
+        writeBackLine(cache, idx);
+    } else if (next->inclusion == INCLUSION_EXCLUSIVE) {
+        next->write_block(next->impl, block_addr, line->block, 1 << cache->word_index_bitcount,
+                          STORE_CLEAN_VICTIM);
+    }
+    dropLine(cache, idx);
+}
+
+// Returns line holding the block of address without allocating, or FA_NO_LINE
+static uint32_t probeLine(FACache *cache, uint32_t address) {
+    return cache->hash_lines[hashFind(cache, address >> (cache->word_index_bitcount + 2))];
+}
+
+// Writes word at word aligned address through to the level below, by way
+// of the write buffer if there is one
+static int writeThrough(FACache *cache, uint32_t address, uint32_t *word) {
+    BackingStore *next = cache->store.next;
+    if (cache->write_buffer != NULL) {
+        return writeBufferWrite(cache->write_buffer, next, address, word, 1);
+    }
+    return next->write_block(next->impl, address, word, 1, STORE_WRITE_THROUGH);
+}
+
+// Finds line holding address, filling a free line (evicting the one
+// chosen by the replacement policy if there is none) on a miss. The new
+// line is filled from the level below unless fill is zero, in which case
+// the caller overwrites the whole block. access is counted in stats.
+// Returns NULL if the block cannot be read from the level below.
+static FACacheLine *lookupLine(FACache *cache, uint32_t address, uint32_t fill, StatsAccess access) {
+    uint32_t addr_tag = address >> (cache->word_index_bitcount + 2);
+    uint32_t bucket = hashFind(cache, addr_tag);
+    uint32_t idx = cache->hash_lines[bucket];
+
+    countAccess(&cache->stats, 0, access, idx != FA_NO_LINE);
+    if (idx != FA_NO_LINE) {
+        cache->policy->hit(cache->policy, 0, idx);
+    } else {
+        // Line does not have the block we want. Go get it.
+        if (cache->free_count == 0) {
+            evictLine(cache, cache->policy->victim(cache->policy, 0));
+            countEviction(&cache->stats, 0);
+        }
+        idx = cache->free_lines[--cache->free_count];
+        FACacheLine *line = &cache->lines[idx];
+
+        uint32_t block_start_address = address & (0xffffffff << (cache->word_index_bitcount+2));
+        uint32_t block_size = (1 << cache->word_index_bitcount);
+        uint8_t dirty = 0;
+        BackingStore *next = cache->store.next;
+        // Pending writes to the block must reach it before it is read
+        if (cache->write_buffer != NULL &&
+            drainWriteBufferBlock(cache->write_buffer, next, block_start_address) != 0) {
+            cache->free_count++;
+            return NULL;
+        }
+        if (fill && next->read_block(next->impl, block_start_address, line->block, block_size, &dirty) != 0) {
+            cache->free_count++;
+            return NULL;
+        }
+        if (fill) {
+            cache->stats.fills++;
+        }
+
+        bucket = hashFind(cache, addr_tag);
+        cache->hash_tags[bucket] = addr_tag;
+        cache->hash_lines[bucket] = idx;
+        cache->policy->fill(cache->policy, 0, idx);
+        line->valid = 1;
+        line->dirty = dirty;
+        line->tag = addr_tag;
+    }
+
+    return &cache->lines[idx];
+}
+
+//----------------------
+// Backing store callbacks used by the level above (see backing_store.h)
+
+static int faReadStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, uint8_t *dirty) {
+    FACache *cache = (FACache *) impl;
+    uint32_t offset = (address >> 2) & ((1 << cache->word_index_bitcount) - 1);
+    FACacheLine *line;
+
+    *dirty = 0;
+    if (cache->store.inclusion == INCLUSION_EXCLUSIVE) {
+        // Hand the block up and forget it, or pass the miss through. A
+        // read of part of a block (a no allocate write merging a byte)
+        // leaves the block here for the write that follows.
+        uint32_t idx = probeLine(cache, address);
+        countAccess(&cache->stats, 0, STATS_READ, idx != FA_NO_LINE);
+        if (idx == FA_NO_LINE) {
+            BackingStore *next = cache->store.next;
+            return next->read_block(next->impl, address, values, count, dirty);
+        }
+        line = &cache->lines[idx];
+        memcpy(values, line->block + offset, count * sizeof(uint32_t));
+        if (count != 1u << cache->word_index_bitcount) {
+            return 0;
+        }
+        *dirty = (uint8_t) line->dirty;
+        dropLine(cache, idx);
+        cache->stats.invalidations++;
+        return 0;
+    }
+
+    line = lookupLine(cache, address, 1, STATS_READ);
+    if (line == NULL) {
+        return -1;
+    }
+    memcpy(values, line->block + offset, count * sizeof(uint32_t));
+    return 0;
+}
+
+// Written words bypass the write buffer, so older buffered words of the
+// block are drained first.
+static int faWriteStore(void *impl, uint32_t address, uint32_t *values, uint32_t count, StoreWriteKind kind) {
+    FACache *cache = (FACache *) impl;
+    uint32_t block_words = 1 << cache->word_index_bitcount;
+    uint32_t offset = (address >> 2) & (block_words - 1);
+    BackingStore *next = cache->store.next;
+    FACacheLine *line;
+
+    if (kind != STORE_CLEAN_VICTIM && cache->write_buffer != NULL &&
+        drainWriteBufferBlock(cache->write_buffer, next,
+                              address & (0xffffffff << (cache->word_index_bitcount + 2))) != 0) {
+        return -1;
+    }
+    if (kind == STORE_CLEAN_VICTIM ||
+        (kind == STORE_WRITE_BACK && cache->write_policy.miss == WRITE_MISS_ALLOCATE)) {
+        line = lookupLine(cache, address, count != block_words,
+                          kind == STORE_CLEAN_VICTIM ? STATS_NO_ACCESS : STATS_WRITE);
+        if (line == NULL) {
+            return -1;
+        }
+    } else {
+        // Update a resident block, otherwise pass the words down
+        uint32_t idx = probeLine(cache, address);
+        countAccess(&cache->stats, 0, STATS_WRITE, idx != FA_NO_LINE);
+        if (idx == FA_NO_LINE) {
+            return next->write_block(next->impl, address, values, count, kind);
+        }
+        line = &cache->lines[idx];
+    }
+
+    memcpy(line->block + offset, values, count * sizeof(uint32_t));
+    if (kind == STORE_CLEAN_VICTIM) {
+        return 0;
+    }
+    if (cache->write_policy.hit == WRITE_HIT_THROUGH) {
+        return next->write_block(next->impl, address, values, count, kind);
+    }
+    line->dirty = 1;
+    return 0;
+}
+
+static void faInvalidateStore(void *impl, uint32_t address, uint32_t count) {
+    FACache *cache = (FACache *) impl;
+    uint32_t block_bytes = 4 << cache->word_index_bitcount;
+    uint64_t end = (uint64_t) address + count * sizeof(uint32_t);
+
+    for (uint64_t block_addr = address; block_addr < end; block_addr += block_bytes) {
+        uint32_t idx = probeLine(cache, (uint32_t) block_addr);
+        if (idx != FA_NO_LINE) {
+            evictLine(cache, idx);
+            cache->stats.invalidations++;
+        }
+    }
+}
+
+static uint32_t bit_select(uint32_t num, uint32_t startbit, uint32_t endbit) {
      uint32_t topmask = 0xffffffff;
     return (num >> endbit) & (~(topmask << (startbit-endbit+1)));
 }
@@ -71,7 +403,7 @@ FACacheResult readByte(FACache *cache, uint32_t address, uint8_t *value) {
         return FA_INVALID_CACHE;
     }
 
-    if (address > (1 << cache->mem->address_width)) {
+    if ((uint64_t) address > (1ULL << cache->mem->address_width)) {
         return FA_CACHE_ADDRESS_OUT_OF_RANGE;
     }
 
@@ -79,87 +411,75 @@ FACacheResult readByte(FACache *cache, uint32_t address, uint8_t *value) {
         return FA_INVALID_VALUE_PTR;
     }
 
-    FACacheLine *line = NULL;
-    uint32_t least_used = 0;
-    uint32_t addr_tag = address >> (cache->word_index_bitcount + 2);
+    return readLine(cache, address, value);
+}
 
-    for (uint32_t i=0; i<cache->num_cache_lines;i++) {
-        if (!cache->lines[i].valid){
-            line = &cache->lines[i];
-            break;
-        }
-        if (cache->lines[least_used].use_identification > cache->lines[i].use_identification){
-            least_used = i;
-        }
-        if (addr_tag == cache->lines[i].tag){
-            line = &cache->lines[i];
-            break;
-        }
-    }
-    if (line == NULL){
-        line = &cache->lines[least_used];
+// Body of readByte
+static FACacheResult readLine(FACache *cache, uint32_t address, uint8_t *value) {
+    FACacheLine *line = lookupLine(cache, address, 1, STATS_READ);
+    if (line == NULL) {
+        return FA_UNIT_FAIL;
     }
-    if ((!line->valid) || (line->tag != addr_tag)) {
-        // Line does not have the block we want. Go get it.
-        
-        uint32_t block_start_address = address & (0xffffffff << (cache->word_index_bitcount+2));
-        uint32_t block_size = (1 << cache->word_index_bitcount);
-        for (uint32_t i=0; i<block_size; i++) {
-            if (readWord(cache->mem, block_start_address + (i*sizeof(uint32_t)), &(line->block[i])) != MM_SUCCESS) {
-                return FA_UNIT_FAIL;
-            }
-        }
-        line->valid = 1;
-        line->tag = addr_tag;
-   }
 
-   uint32_t word_index = bit_select(address, 1+cache->word_index_bitcount, 2);
+   uint32_t word_index = (address >> 2) & ((1 << cache->word_index_bitcount) - 1);
    uint32_t word = line->block[word_index];
    uint32_t byte_offset = address % sizeof(uint32_t);
    *value = ((word >> (8*byte_offset)) & 0x000000ff);
-    line->use_identification = cache->use_count++;
     return FA_CACHE_SUCCESS;
 }
 
+// Writes value at address to the level below without allocating. A
+// resident line (idx != FA_NO_LINE, write around) is updated and evicted,
+// which writes it back if dirty; a clean one has just the written word
+// written through.
+static FACacheResult writeAround(FACache *cache, uint32_t address, uint8_t value, uint32_t idx) {
+    BackingStore *next = cache->store.next;
+    int status;
+    if (idx == FA_NO_LINE) {
+        if (cache->write_buffer != NULL) {
+            status = writeBufferWriteByte(cache->write_buffer, next, address, value);
+        } else {
+            status = storeWriteByte(next, address, value);
+        }
+        return status == 0 ? FA_CACHE_SUCCESS : FA_UNIT_FAIL;
+    }
+
+    FACacheLine *line = &cache->lines[idx];
+    uint32_t *word = &line->block[(address >> 2) & ((1 << cache->word_index_bitcount) - 1)];
+    *word = mergeByte(*word, address, value);
+    status = line->dirty ? 0 : writeThrough(cache, address & ~(uint32_t) 3, word);
+    evictLine(cache, idx);
+    countEviction(&cache->stats, 0);
+    return status == 0 ? FA_CACHE_SUCCESS : FA_UNIT_FAIL;
+}
+
 FACacheResult writeByte(FACache *cache, uint32_t address, uint8_t value) {
     if (cache == NULL) {
         return FA_INVALID_CACHE;
     }
 
-    if (address > (1 << cache->mem->address_width)) {
+    if ((uint64_t) address > (1ULL << cache->mem->address_width)) {
         return FA_CACHE_ADDRESS_OUT_OF_RANGE;
     }
 
-    uint32_t addr_tag = address >> (2+cache->word_index_bitcount);
-    uint32_t most_recently_used = 0;
-    FACacheLine *line = NULL;
-    for (uint32_t i = 0; i < cache->num_cache_lines; i++) {
-        if (!cache->lines[i].valid) {
-            line = &cache->lines[i];
-            break;
-        }
-        if (cache->lines[most_recently_used].use_identification > cache->lines[i].use_identification) {
-            most_recently_used = i;
-        }
-        if (addr_tag == cache->lines[i].tag) {
-            line = &cache->lines[i];
-            break;
+    return writeLine(cache, address, value);
+}
+
+// Body of writeByte
+static FACacheResult writeLine(FACache *cache, uint32_t address, uint8_t value) {
+    if (cache->write_policy.miss != WRITE_MISS_ALLOCATE) {
+        uint32_t idx = probeLine(cache, address);
+        if (idx == FA_NO_LINE || cache->write_policy.miss == WRITE_MISS_AROUND) {
+            countAccess(&cache->stats, 0, STATS_WRITE, idx != FA_NO_LINE);
+            return writeAround(cache, address, value, idx);
         }
     }
+
+    FACacheLine *line = lookupLine(cache, address, 1, STATS_WRITE);
     if (line == NULL) {
-        line = &cache->lines[most_recently_used];
-    }
-    if (!line->valid || line->tag != addr_tag) {
-        uint32_t block_start_address = address & (0xffffffff << (cache->word_index_bitcount + 2));
-        for (uint32_t k = 0; k < (1 << cache->word_index_bitcount); k++) {
-            if (readWord(cache->mem, block_start_address + (k*sizeof(uint32_t)), &(line->block[k])) != MM_SUCCESS) {
-                return FA_UNIT_FAIL;
-            }
-        }
-        line->valid = 1;
-        line->tag = addr_tag;
+        return FA_UNIT_FAIL;
     }
-    uint32_t word_index = bit_select(address, 1+cache->word_index_bitcount, 2);
+    uint32_t word_index = (address >> 2) & ((1 << cache->word_index_bitcount) - 1);
     uint32_t *word = &line->block[word_index];
     uint32_t byte_offset = address % sizeof(uint32_t);
     uint32_t newest_word = 0;
@@ -174,13 +494,98 @@ FACacheResult writeByte(FACache *cache, uint32_t address, uint8_t value) {
     }
 
     *word = newest_word;
-    uint32_t word_addr = address & (0xffffffff << 2);
-    if (writeWord(cache->mem, word_addr, newest_word) != MM_SUCCESS) {
+    if (cache->write_policy.hit == WRITE_HIT_BACK) {
+        line->dirty = 1;
+    } else if (writeThrough(cache, address & (0xffffffff << 2), word) != 0) {
         return FA_UNIT_FAIL;
     }
 
-    line->use_identification = cache->use_count++;
     return FA_CACHE_SUCCESS;
 }
 
+// Prefetches the home hash bucket of addresses[i], if i < count
+static inline void prefetchBucket(FACache *cache, const uint32_t *addresses, uint32_t i, uint32_t count) {
+    if (i < count) {
+        uint32_t bucket = ((addresses[i] >> (cache->word_index_bitcount + 2)) * 2654435761u) >> cache->hash_shift;
+        __builtin_prefetch(&cache->hash_tags[bucket]);
+        __builtin_prefetch(&cache->hash_lines[bucket]);
+    }
+}
+
+FACacheResult readBytes(FACache *cache, const uint32_t *addresses, uint8_t *values,
+                        uint32_t count, uint32_t *errors) {
+    if (cache == NULL) {
+        return FA_INVALID_CACHE;
+    }
+
+    if (count > 0 && (addresses == NULL || values == NULL)) {
+        return FA_INVALID_VALUE_PTR;
+    }
+
+    uint64_t limit = 1ULL << cache->mem->address_width;
+    FACacheResult first = FA_CACHE_SUCCESS;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        prefetchBucket(cache, addresses, i + BATCH_PREFETCH_DISTANCE, count);
+        FACacheResult result = addresses[i] <= limit ? readLine(cache, addresses[i], &values[i])
+                                                     : FA_CACHE_ADDRESS_OUT_OF_RANGE;
+        if (result != FA_CACHE_SUCCESS && failed++ == 0) {
+            first = result;
+        }
+    }
+    if (errors != NULL) {
+        *errors = failed;
+    }
+    return first;
+}
+
+FACacheResult writeBytes(FACache *cache, const uint32_t *addresses, const uint8_t *values,
+                         uint32_t count, uint32_t *errors) {
+    if (cache == NULL) {
+        return FA_INVALID_CACHE;
+    }
+
+    if (count > 0 && (addresses == NULL || values == NULL)) {
+        return FA_INVALID_VALUE_PTR;
+    }
+
+    uint64_t limit = 1ULL << cache->mem->address_width;
+    FACacheResult first = FA_CACHE_SUCCESS;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        prefetchBucket(cache, addresses, i + BATCH_PREFETCH_DISTANCE, count);
+        FACacheResult result = addresses[i] <= limit ? writeLine(cache, addresses[i], values[i])
+                                                     : FA_CACHE_ADDRESS_OUT_OF_RANGE;
+        if (result != FA_CACHE_SUCCESS && failed++ == 0) {
+            first = result;
+        }
+    }
+    if (errors != NULL) {
+        *errors = failed;
+    }
+    return first;
+}
+
+void flushFACache(FACache *cache) {
+    BackingStore *above = cache->store.above;
+    for (uint32_t i = 0; i < cache->num_cache_lines; i++) {
+        FACacheLine *line = &cache->lines[i];
+        if (!line->valid) {
+            continue;
+        }
+        if (cache->store.inclusion == INCLUSION_INCLUSIVE && above != NULL) {
+            above->invalidate_block(above->impl, line->tag << (cache->word_index_bitcount + 2),
+                                    1 << cache->word_index_bitcount);
+        }
+        writeBackLine(cache, i);
+        dropLine(cache, i);
+    }
+    // Refill in index order, as after createFACache
+    for (uint32_t i = 0; i < cache->num_cache_lines; i++) {
+        cache->free_lines[i] = cache->num_cache_lines - 1 - i;
+    }
+    resetReplacementPolicy(cache->policy);
+    drainFAWriteBuffer(cache);
+}
+
 
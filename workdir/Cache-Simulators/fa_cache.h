@@ -4,25 +4,60 @@
 #define FA_CACHE_H
 #include <stdint.h>
 #include "main_mem.h"
+#include "replacement.h"
+#include "write_buffer.h"
+#include "cache_stats.h"
 
 // FACache
 // 
 // Models a fully associative write through cache in front of a main memory model.
-// Provides byte-level read interface. Replacement policy is least recently used.
+// Provides byte-level read interface. Replacement policy is least recently used
+// unless another ReplacementPolicy is chosen with createFACacheWithPolicy. Writes
+// are write through, write allocate unless changed with setFAWritePolicy.
+//
+// Lines are indexed by an open addressing tag -> line hash table, and the
+// replacement policy treats the cache as a single set, so hit detection
+// takes constant time regardless of num_cache_lines (as does victim
+// selection under LRU, FIFO and random). Invalid lines are kept on a free
+// stack, filled in index order at first.
+//
+// Fills and write throughs go through store.next, which is mem's
+// BackingStore unless the cache is stacked on another level with
+// linkBackingStores. mem is always the MainMem at the bottom.
+//
+// An optional coalescing WriteBuffer (write_buffer.h), attached with
+// attachFAWriteBuffer, sits between the cache and store.next and absorbs
+// the word written through by every writeByte, including bytes written
+// around a no write allocate cache.
+//
+// stats (cache_stats.h) counts the cache as a single set.
 typedef struct FACacheLine {
-    uint32_t use_identification;
     uint32_t tag;
     uint32_t *block;
     uint32_t valid;
+    uint32_t dirty;             // Only ever set in a write back cache
 } FACacheLine;
 typedef struct FACache {
     uint32_t word_index_bitcount;
     uint32_t num_cache_lines;
-    uint32_t use_count;
     MainMem *mem;
     FACacheLine *lines;
+    ReplacementPolicy *policy;
+    uint32_t *free_lines;       // Stack of invalid line indices
+    uint32_t free_count;
+    uint32_t hash_shift;        // Hash table has (1 << (32 - hash_shift)) buckets
+    uint32_t hash_mask;
+    uint32_t *hash_tags;
+    uint32_t *hash_lines;       // FA_NO_LINE for unused buckets
+    BackingStore store;         // This cache as seen by the level above; store.next is the level below
+    WriteBuffer *write_buffer;  // NULL unless attached with attachFAWriteBuffer
+    WritePolicy write_policy;
+    CacheStats stats;
 } FACache;
 
+// Marks an empty hash bucket
+#define FA_NO_LINE 0xffffffff
+
 // Enum for result codes returned by readByte
 
 typedef enum {
@@ -50,8 +85,45 @@ FACache *createFACache(MainMem *mem,                // Underlying MainMem model.
                    uint32_t word_index_bitcount,    // Number of word index bits
                    uint32_t num_cache_lines);       // Number of cache lines.
 
+// createFACacheWithPolicy
+// Same as createFACache with replacement policy chosen by policy.
+// Returns NULL on error, including geometries the policy does not support.
+
+FACache *createFACacheWithPolicy(MainMem *mem,
+                                 uint32_t word_index_bitcount,
+                                 uint32_t num_cache_lines,
+                                 ReplacementType policy);
+
+// setFAWritePolicy
+// Sets the write hit and miss policies of cache (see backing_store.h).
+// Writes from the level above follow them as in setSAWritePolicy. Must
+// be called before the cache is linked below another level.
+
+void setFAWritePolicy(FACache *cache, WritePolicy policy);
+
+// attachFAWriteBuffer
+// Attaches a coalescing write buffer of num_entries blocks to cache,
+// draining and replacing any previous one. Returns 0 on success, -1 if
+// the buffer cannot be created.
+
+int attachFAWriteBuffer(FACache *cache, uint32_t num_entries);
+
+// drainFAWriteBuffer
+// Writes every entry of the cache's write buffer to the level below.
+// Does nothing if the cache has no write buffer.
+// Returns FA_CACHE_SUCCESS, or FA_UNIT_FAIL if a write fails.
+
+FACacheResult drainFAWriteBuffer(FACache *cache);
+
+// flushFACache
+// Writes back any dirty cache lines, drains the write buffer and
+// invalidates all cache lines.
+
+void flushFACache(FACache *cache);
+
 // freeFACache
-// Frees the memory used by cache.
+// Frees the memory used by cache. Pending write buffer entries and dirty
+// lines are discarded; write them out first with flushFACache.
 void freeFACache(FACache *cache);
 
 // readByte
@@ -73,4 +145,22 @@ FACacheResult readByte(FACache *cache, uint32_t address, uint8_t *value);
 
 FACacheResult writeByte(FACache *cache, uint32_t address, uint8_t value);
 
+// readBytes
+// Reads the byte at each of count addresses into values, in order, as
+// count calls of readByte would. cache and the arrays are checked once,
+// returning FA_INVALID_CACHE or FA_INVALID_VALUE_PTR before any read.
+// Returns FA_CACHE_SUCCESS if every read succeeded, otherwise the result
+// of the first that failed; the reads after it are still performed.
+// errors, if not NULL, receives the number of reads that failed.
+
+FACacheResult readBytes(FACache *cache, const uint32_t *addresses, uint8_t *values,
+                        uint32_t count, uint32_t *errors);
+
+// writeBytes
+// Writes values[i] at addresses[i] for each of count addresses, in order,
+// as count calls of writeByte would. Returns as readBytes.
+
+FACacheResult writeBytes(FACache *cache, const uint32_t *addresses, const uint8_t *values,
+                         uint32_t count, uint32_t *errors);
+
 #endif
@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include "fa_cache.h"
+#include "cache_model.h"
+
+// Adapter exposing FACache through the CacheModel interface.
+// Compiled with FA_NAMESPACE (see Makefile).
+
+static int faReadByteModel(void *cache, uint32_t address, uint8_t *value) {
+    return readByte((FACache *) cache, address, value);
+}
+
+static int faWriteByteModel(void *cache, uint32_t address, uint8_t value) {
+    return writeByte((FACache *) cache, address, value);
+}
+
+static int faReadBytesModel(void *cache, const uint32_t *addresses, uint8_t *values, uint32_t count,
+                            uint32_t *errors) {
+    return readBytes((FACache *) cache, addresses, values, count, errors);
+}
+
+static int faWriteBytesModel(void *cache, const uint32_t *addresses, const uint8_t *values, uint32_t count,
+                             uint32_t *errors) {
+    return writeBytes((FACache *) cache, addresses, values, count, errors);
+}
+
+static void faFlushModel(void *cache) {
+    flushFACache((FACache *) cache);
+}
+
+static void faFreeModel(void *cache) {
+    freeFACache((FACache *) cache);
+}
+
+CacheModel *createFACacheModel(MainMem *mem, CacheConfig *config) {
+    CacheModel *model = (CacheModel *) malloc(sizeof(CacheModel));
+    if (model == NULL) {
+        return NULL;
+    }
+
+    model->cache = createFACacheWithPolicy(mem, config->word_index_bitcount,
+                                           config->lines_per_set, config->policy);
+    if (model->cache == NULL) {
+        free(model);
+        return NULL;
+    }
+    FACache *fa_cache = (FACache *) model->cache;
+    setFAWritePolicy(fa_cache, config->write_policy);
+    if (config->write_buffer_entries != 0 &&
+        attachFAWriteBuffer(fa_cache, config->write_buffer_entries) != 0) {
+        freeFACache(fa_cache);
+        free(model);
+        return NULL;
+    }
+
+    model->config = *config;
+    model->mem = mem;
+    model->read_byte = faReadByteModel;
+    model->write_byte = faWriteByteModel;
+    model->read_bytes = faReadBytesModel;
+    model->write_bytes = faWriteBytesModel;
+    model->flush = faFlushModel;
+    model->free_cache = faFreeModel;
+    model->store = &fa_cache->store;
+    model->stats = &fa_cache->stats;
+    model->prefetch_stats = NULL;
+    model->write_buffer_stats = fa_cache->write_buffer != NULL ? &fa_cache->write_buffer->stats : NULL;
+    model->lower = NULL;
+    return model;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main_mem.h"
+#include "cache_model.h"
+#include "sa_cache.h"
+#include "tag_match.h"
+
+#define ADDRESS_WIDTH 11
+#define MEM_BYTES (1 << ADDRESS_WIDTH)
+#define NUM_ACCESSES 20000
+
+// Returns 1 if the SACache holds the block containing address
+static int holdsBlock(SACache *cache, uint32_t address) {
+    uint32_t tag = address >> (cache->set_index_bitcount + cache->word_index_bitcount + 2);
+    uint32_t set = (address >> (cache->word_index_bitcount + 2)) & ((1 << cache->set_index_bitcount) - 1);
+    return findTag(cache->sets[set].tags, cache->ways_stride, tag) >= 0;
+}
+
+// Counts blocks of upper that are (or are not) also held by lower
+static void countShared(SACache *upper, SACache *lower, uint32_t *shared, uint32_t *alone) {
+    *shared = 0;
+    *alone = 0;
+    for (uint32_t set=0; set<(1u << upper->set_index_bitcount); set++) {
+        for (uint32_t way=0; way<upper->lines_per_set; way++) {
+            if (!upper->sets[set].valid[way]) {
+                continue;
+            }
+            uint32_t address = (upper->sets[set].tags[way] << (upper->set_index_bitcount + upper->word_index_bitcount + 2)) |
+                               (set << (upper->word_index_bitcount + 2));
+            if (holdsBlock(lower, address)) {
+                (*shared)++;
+            } else {
+                (*alone)++;
+            }
+        }
+    }
+}
+
+// Replays a random workload through spec, checking every read against a
+// shadow copy of memory and memory itself after the final flush.
+// Returns MainMem fill reads, or exits on a mismatch. check, if not
+// NULL, inspects the hierarchy before the flush.
+static uint64_t checkHierarchy(char *spec, void (*check)(CacheModel *model)) {
+    CacheConfig config;
+    if (parseCacheConfig(spec, &config) != 0) {
+        printf("parseCacheConfig failed for %s\n", spec);
+        exit(-1);
+    }
+
+    MainMem *main_mem = createMainMem(ADDRESS_WIDTH);
+    CacheModel *model = createCacheModel(main_mem, &config);
+    if (model == NULL) {
+        printf("createCacheModel failed for %s\n", spec);
+        exit(-1);
+    }
+
+    uint8_t shadow[MEM_BYTES] = {0};
+    uint32_t state = 2024;
+    for (uint32_t i=0; i<NUM_ACCESSES; i++) {
+        state = state * 1103515245 + 12345;
+        uint32_t r = state >> 8;
+        uint32_t address = (r & 1) ? (r >> 1) % 256 : (r >> 1) % MEM_BYTES;
+        uint8_t value;
+
+        if (((r >> 14) & 3) == 0 && model->write_byte != NULL) {
+            value = (uint8_t) (r >> 20);
+            if (model->write_byte(model->cache, address, value) != 0) {
+                printf("write_byte failed for %s\n", spec);
+                exit(-1);
+            }
+            shadow[address] = value;
+        } else {
+            if (model->read_byte(model->cache, address, &value) != 0) {
+                printf("read_byte failed for %s\n", spec);
+                exit(-1);
+            }
+            if (value != shadow[address]) {
+                printf("%s read %u at 0x%x, expected %u\n", spec, value, address, shadow[address]);
+                exit(-1);
+            }
+        }
+    }
+
+    if (check != NULL) {
+        check(model);
+    }
+    flushCacheModel(model);
+
+    for (uint32_t address=0; address<MEM_BYTES; address+=4) {
+        uint32_t word;
+        readWord(main_mem, address, &word);
+        for (uint32_t b=0; b<4; b++) {
+            if (((word >> (8*b)) & 0xff) != shadow[address + b]) {
+                printf("%s left wrong data in memory at 0x%x\n", spec, address + b);
+                exit(-1);
+            }
+        }
+    }
+
+    uint64_t fills = main_mem->op_log->readTotal - MEM_BYTES / 4;
+    freeCacheModel(model);
+    freeMainMem(main_mem);
+    return fills;
+}
+
+static void checkInclusive(CacheModel *model) {
+    uint32_t shared, alone;
+    countShared((SACache *) model->cache, (SACache *) model->lower->cache, &shared, &alone);
+    if (alone != 0 || shared == 0) {
+        printf("Inclusive L2 is missing %u L1 blocks\n", alone);
+        exit(-1);
+    }
+}
+
+static void checkExclusive(CacheModel *model) {
+    uint32_t shared, alone;
+    countShared((SACache *) model->cache, (SACache *) model->lower->cache, &shared, &alone);
+    if (shared != 0 || alone == 0) {
+        printf("Exclusive L2 duplicates %u L1 blocks\n", shared);
+        exit(-1);
+    }
+}
+
+int main() {
+    uint64_t l1_only = checkHierarchy("sa:2:1:2", NULL);
+    uint64_t nine = checkHierarchy("sa:2:1:2/sa:4:1:4", NULL);
+    uint64_t incl = checkHierarchy("sa:2:1:2/sa:4:1:4,incl", checkInclusive);
+    uint64_t excl = checkHierarchy("sa:2:1:2/sa:4:1:4,excl", checkExclusive);
+    if (nine >= l1_only || incl >= l1_only || excl >= l1_only) {
+        printf("Expected L2 to reduce memory reads\n");
+        exit(-1);
+    }
+    if (excl > nine) {
+        printf("Expected exclusive L2 to hold at least as much as non-inclusive\n");
+        exit(-1);
+    }
+
+    checkHierarchy("sa:1:1:2/sa:2:2:2:plru/sa:3:2:4:srrip,incl", NULL);
+    checkHierarchy("sa:1:1:2/sa:2:1:2/sa:3:1:4,excl", NULL);
+    checkHierarchy("fa:1:8/sa:3:2:4,incl", NULL);
+    checkHierarchy("fa:1:8/sa:3:2:4", NULL);
+    checkHierarchy("sa:2:1:2/fa:2:16,incl", NULL);
+    checkHierarchy("dm:3:1/sa:4:2:2,incl", NULL);
+    checkHierarchy("sa:2:0:2/dm:5:1,incl", NULL);
+
+    // Links that cannot be built
+    CacheConfig config;
+    MainMem *main_mem = createMainMem(ADDRESS_WIDTH);
+    char *bad[] = {"sa:2:2:2/sa:4:1:4", "sa:2:1:2/sa:3:2:4,excl", "fa:1:8/sa:3:1:4,excl"};
+    for (uint32_t i=0; i<3; i++) {
+        if (parseCacheConfig(bad[i], &config) != 0) {
+            printf("parseCacheConfig failed for %s\n", bad[i]);
+            exit(-1);
+        }
+        if (createCacheModel(main_mem, &config) != NULL) {
+            printf("Expected createCacheModel to reject %s\n", bad[i]);
+            exit(-1);
+        }
+    }
+    freeMainMem(main_mem);
+
+    if (parseCacheConfig("sa:2:1:2/sa:4:1:4,bogus", &config) == 0 ||
+        parseCacheConfig("sa:1:1:1/sa:1:1:1/sa:1:1:1/sa:1:1:1/sa:1:1:1", &config) == 0) {
+        printf("Expected parseCacheConfig to reject malformed hierarchy\n");
+        exit(-1);
+    }
+
+    // A string too long for the buffer is truncated and terminated
+    // wherever a level ends, including exactly at its last byte
+    if (parseCacheConfig("sa:1:1:1:fifo+through+3c/sa:1:1:1:fifo+through+3c/"
+                         "sa:1:1:1:fifo+through+3c/sa:1:1:1:fifo+through+3c,incl", &config) != 0) {
+        printf("parseCacheConfig failed for four levels\n");
+        exit(-1);
+    }
+    uint32_t magnitudes[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    char spec[CACHE_CONFIG_STR_LEN];
+    for (uint32_t first=0; first<10; first++) {
+        for (uint32_t rest=0; rest<10; rest++) {
+            config.set_index_bitcount = magnitudes[rest];
+            config.word_index_bitcount = magnitudes[rest];
+            config.lines_per_set = magnitudes[first];
+            for (uint32_t i=0; i<config.num_lower; i++) {
+                config.lower[i].set_index_bitcount = magnitudes[rest];
+                config.lower[i].word_index_bitcount = magnitudes[rest];
+                config.lower[i].lines_per_set = magnitudes[rest];
+            }
+            memset(spec, 'x', sizeof(spec));
+            formatCacheConfig(&config, spec);
+            if (memchr(spec, '\0', sizeof(spec)) == NULL) {
+                printf("formatCacheConfig left the string unterminated\n");
+                exit(-1);
+            }
+        }
+    }
+
+    printf("Hierarchy Test 01 Finished\n");
+}
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+#include "log_binary.h"
+#include "log_format.h"
+
+static void flushBytes(LogEncoder *encoder) {
+    if (encoder->used > 0 && fwrite(encoder->bytes, 1, encoder->used, encoder->file) != encoder->used) {
+        encoder->failed = 1;
+    }
+    encoder->used = 0;
+}
+
+static inline void putVarint(LogEncoder *encoder, uint64_t value) {
+    if (encoder->used + 10 > LOG_BINARY_BUFFER_SIZE) {
+        flushBytes(encoder);
+    }
+    uint8_t *out = encoder->bytes + encoder->used;
+    while (value >= 0x80) {
+        *out++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t) value;
+    encoder->used = out - encoder->bytes;
+}
+
+// Maps small deltas of either sign to small numbers: 0, -1, 1, -2, ...
+static inline uint64_t zigzag(int64_t delta) {
+    return ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+// Encodes the pending run, if any
+static void writeRun(LogEncoder *encoder) {
+    if (encoder->run_count == 0) {
+        return;
+    }
+    putVarint(encoder, ((uint64_t) encoder->run_count << 1) | encoder->run_op);
+    putVarint(encoder, zigzag((int64_t) encoder->run_start - (int64_t) encoder->next_index));
+    for (uint32_t i = 0; i < encoder->run_count; i++) {
+        putVarint(encoder, encoder->run_values[i]);
+    }
+    encoder->next_index = encoder->run_start + encoder->run_count;
+    encoder->run_count = 0;
+}
+
+LogEncoder *createLogEncoder(FILE *file) {
+    if (file == NULL) {
+        return NULL;
+    }
+    LogEncoder *encoder = (LogEncoder *) calloc(1, sizeof(LogEncoder));
+    if (encoder == NULL) {
+        return NULL;
+    }
+    encoder->file = file;
+    LogBinaryHeader header = {LOG_BINARY_MAGIC, LOG_BINARY_VERSION};
+    memcpy(encoder->bytes, &header, sizeof(header));
+    encoder->used = sizeof(header);
+    return encoder;
+}
+
+void encodeLogEntries(LogEncoder *encoder, const MainMemOpLogEntry *entries, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const MainMemOpLogEntry *entry = &entries[i];
+        if (encoder->run_count == 0 || entry->op != encoder->run_op ||
+            entry->wordIndex != encoder->run_start + encoder->run_count ||
+            encoder->run_count == LOG_BINARY_MAX_RUN) {
+            writeRun(encoder);
+            encoder->run_op = entry->op;
+            encoder->run_start = entry->wordIndex;
+        }
+        encoder->run_values[encoder->run_count++] = entry->value;
+    }
+}
+
+//----------------------
+// closeLogEncoder
+//
+// Arguments: encoder - encoder to close
+//            op_log - log whose counts end the file, or NULL
+//
+// Results: 0 on success, -1 if any write failed. Counts are read a page
+//          of words at a time, as by writeLogCounts, so only words
+//          accessed are visited in a sparse log.
+//
+int closeLogEncoder(LogEncoder *encoder, MainMemOpLog *op_log) {
+    writeRun(encoder);
+    putVarint(encoder, 0);
+
+    uint32_t word_count = op_log != NULL ? op_log->wordCount : 0;
+    uint64_t next_word = 0;
+    putVarint(encoder, word_count);
+    for (uint64_t first = 0; first < word_count; first += PT_PAGE_WORDS) {
+        uint32_t words = (word_count - first < PT_PAGE_WORDS) ? (uint32_t) (word_count - first) : PT_PAGE_WORDS;
+        const uint32_t *reads;
+        const uint32_t *writes;
+        if (op_log->readCounts != NULL) {
+            reads = op_log->readCounts + first;
+            writes = op_log->writeCounts + first;
+        } else {
+            reads = findPage(op_log->readPages, (uint32_t) first);
+            writes = findPage(op_log->writePages, (uint32_t) first);
+        }
+        for (uint32_t i = 0; (reads != NULL || writes != NULL) && i < words; i++) {
+            uint32_t word_reads = reads != NULL ? reads[i] : 0;
+            uint32_t word_writes = writes != NULL ? writes[i] : 0;
+            if (word_reads == 0 && word_writes == 0) {
+                continue;
+            }
+            putVarint(encoder, first + i - next_word);
+            putVarint(encoder, word_reads);
+            putVarint(encoder, word_writes);
+            next_word = first + i + 1;
+        }
+    }
+    putVarint(encoder, 0);
+    putVarint(encoder, 0);
+    putVarint(encoder, 0);
+    flushBytes(encoder);
+
+    int failed = encoder->failed;
+    free(encoder);
+    return failed ? -1 : 0;
+}
+
+// Buffered reader of a binary log
+typedef struct LogDecoder {
+    FILE *file;
+    size_t pos;
+    size_t len;
+    uint8_t bytes[LOG_BINARY_BUFFER_SIZE];
+} LogDecoder;
+
+// Reads a varint of at most 64 bits. Returns 0 on success, -1 at end of
+// file or on a malformed number.
+static inline int getVarint(LogDecoder *decoder, uint64_t *value) {
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (decoder->pos == decoder->len) {
+            decoder->len = fread(decoder->bytes, 1, LOG_BINARY_BUFFER_SIZE, decoder->file);
+            decoder->pos = 0;
+            if (decoder->len == 0) {
+                return -1;
+            }
+        }
+        uint8_t byte = decoder->bytes[decoder->pos++];
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Reads a varint that must fit in 32 bits
+static inline int getVarint32(LogDecoder *decoder, uint32_t *value) {
+    uint64_t wide;
+    if (getVarint(decoder, &wide) != 0 || wide > UINT32_MAX) {
+        return -1;
+    }
+    *value = (uint32_t) wide;
+    return 0;
+}
+
+// Decodes the entries section into text
+static int decodeEntries(LogDecoder *decoder, LogTextBuffer *text) {
+    uint32_t next_index = 0;
+    appendLogText(text, "Operation Log: \n");
+    for (;;) {
+        uint64_t run_header;
+        uint64_t delta;
+        if (getVarint(decoder, &run_header) != 0) {
+            return -1;
+        }
+        if (run_header == 0) {
+            return 0;
+        }
+        uint64_t run_count = run_header >> 1;
+        if (run_count == 0 || run_count > LOG_BINARY_MAX_RUN || getVarint(decoder, &delta) != 0) {
+            return -1;
+        }
+        MainMemOpLogEntry entry;
+        entry.op = (run_header & 1) ? WRITE_OP : READ_OP;
+        entry.wordIndex = next_index + (uint32_t) unzigzag(delta);
+        for (uint64_t i = 0; i < run_count; i++, entry.wordIndex++) {
+            if (getVarint32(decoder, &entry.value) != 0) {
+                return -1;
+            }
+            text->used += formatEntryLine(logLineRoom(text), &entry);
+        }
+        next_index = entry.wordIndex;
+    }
+}
+
+// Decodes the counts section into text, writing zero counts of words not
+// listed unless skip_zero is non-zero
+static int decodeCounts(LogDecoder *decoder, LogTextBuffer *text, int skip_zero) {
+    uint32_t word_count;
+    uint32_t read_total = 0;
+    uint32_t write_total = 0;
+    uint64_t word = 0;
+    if (getVarint32(decoder, &word_count) != 0) {
+        return -1;
+    }
+
+    appendLogText(text, skip_zero ? "\nOperation Counts: WORD, READ, WRITE\n" : "\nOperation Counts: READ, WRITE\n");
+    for (;;) {
+        uint64_t gap;
+        uint32_t reads;
+        uint32_t writes;
+        if (getVarint(decoder, &gap) != 0 || getVarint32(decoder, &reads) != 0 ||
+            getVarint32(decoder, &writes) != 0) {
+            return -1;
+        }
+        int last = reads == 0 && writes == 0;
+        uint64_t listed = last ? word_count : word + gap;
+        if (listed > word_count || (!last && listed == word_count)) {
+            return -1;
+        }
+        for (; !skip_zero && word < listed; word++) {
+            memcpy(logLineRoom(text), "0, 0\n", 5);
+            text->used += 5;
+        }
+        if (last) {
+            break;
+        }
+        char *line = logLineRoom(text);
+        text->used += skip_zero ? formatWordCountLine(line, (uint32_t) listed, reads, writes)
+                                : formatCountLine(line, reads, writes);
+        read_total += reads;
+        write_total += writes;
+        word = listed + 1;
+    }
+    appendLogTotals(text, read_total, write_total);
+    return 0;
+}
+
+//----------------------
+// decodeBinaryLog
+//
+// Arguments: file_name - binary log to read
+//            out - open file receiving the text log
+//            skip_zero - non-zero to list only words accessed
+//
+// Results: 0 on success, -1 if file_name cannot be read, is not a binary
+//          log of LOG_BINARY_VERSION or is truncated, or out cannot be
+//          written. Text decoded before an error is still written.
+//
+int decodeBinaryLog(char *file_name, FILE *out, int skip_zero) {
+    if (file_name == NULL || out == NULL) {
+        return -1;
+    }
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    LogDecoder *decoder = (LogDecoder *) malloc(sizeof(LogDecoder));
+    LogTextBuffer *text = (LogTextBuffer *) malloc(sizeof(LogTextBuffer));
+    LogBinaryHeader header;
+    int result = -1;
+    if (decoder != NULL && text != NULL && fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == LOG_BINARY_MAGIC && header.version == LOG_BINARY_VERSION) {
+        decoder->file = file;
+        decoder->pos = 0;
+        decoder->len = 0;
+        text->file = out;
+        text->used = 0;
+        result = decodeEntries(decoder, text);
+        if (result == 0) {
+            result = decodeCounts(decoder, text, skip_zero);
+        }
+        flushLogText(text);
+        if (ferror(out)) {
+            result = -1;
+        }
+    }
+    free(decoder);
+    free(text);
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+#include <stdint.h>
+#include <stdio.h>
+#include "main_mem_log.h"
+
+// Binary op log
+//
+// A compact encoding of the text log of writeLogToFile. Numbers are
+// LEB128 varints, little end first, 7 bits per byte. A file is
+//
+//   LogBinaryHeader
+//   runs          each varint (length << 1 | op), varint zigzag(first
+//                 word index - word index following the previous run),
+//                 then length varint values. A run is up to
+//                 LOG_BINARY_MAX_RUN entries of one op on consecutive
+//                 words, so a block fill costs one header and a delta of
+//                 zero on top of its values.
+//   varint 0      end of the entries
+//   varint        word count of the log
+//   counts        each varint (word index - previous listed index - 1),
+//                 varint reads, varint writes, for words accessed only
+//   0, 0, 0       end of the counts
+//
+// Entries are encoded as they arrive, so a log is written in one pass
+// (see LogWriter in log_writer.h). decodeBinaryLog writes the text layout
+// back, word for word the output of writeLogToFile.
+
+// Magic number at the start of every binary log ("CLOG" little endian)
+#define LOG_BINARY_MAGIC 0x474f4c43
+
+// Current binary log format version
+#define LOG_BINARY_VERSION 1
+
+// Longest run of entries sharing a header
+#define LOG_BINARY_MAX_RUN 1024
+
+// Bytes buffered by an encoder or decoder between file accesses
+#define LOG_BINARY_BUFFER_SIZE (64 * 1024)
+
+typedef struct LogBinaryHeader {
+    uint32_t magic;
+    uint32_t version;
+} LogBinaryHeader;
+
+// Encoder state carried across calls to encodeLogEntries
+typedef struct LogEncoder {
+    FILE *file;
+    int failed;                 // Non-zero once a write failed
+    uint32_t next_index;        // Word index following the last run written
+    MemOp run_op;
+    uint32_t run_start;         // First word index of the pending run
+    uint32_t run_count;         // Entries of the pending run, 0 if none
+    uint32_t run_values[LOG_BINARY_MAX_RUN];
+    size_t used;                // Bytes of bytes not yet written
+    uint8_t bytes[LOG_BINARY_BUFFER_SIZE];
+} LogEncoder;
+
+// Creates an encoder writing to file, an open binary file, and writes
+// the header. Returns NULL on error.
+LogEncoder *createLogEncoder(FILE *file);
+
+// Encodes count entries following the ones already encoded
+void encodeLogEntries(LogEncoder *encoder, const MainMemOpLogEntry *entries, uint32_t count);
+
+// Ends the entries, writes the counts of op_log (none if op_log is NULL)
+// and frees encoder, leaving its file open. Returns 0 on success, -1 if
+// any write failed.
+int closeLogEncoder(LogEncoder *encoder, MainMemOpLog *op_log);
+
+// Writes the binary log in file_name to out in the text layout of
+// writeLogToFile, leaving out words never accessed if skip_zero is
+// non-zero (see writeLogCounts). Returns 0 on success, -1 if the file
+// cannot be read or is not a valid binary log.
+int decodeBinaryLog(char *file_name, FILE *out, int skip_zero);
+
+#endif